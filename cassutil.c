@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cassutil.h"
+
+void print_error(CassFuture* future) {
+  const char* message;
+  size_t message_length;
+  cass_future_error_message(future, &message, &message_length);
+  fprintf(stderr, "Error: %.*s\n", (int)message_length, message);
+}
+
+CassCluster* create_cluster(const char* contact_points) {
+  CassCluster* cluster = cass_cluster_new();
+  cass_cluster_set_contact_points(cluster, contact_points);
+  return cluster;
+}
+
+CassError connect_session(CassSession* session, const CassCluster* cluster) {
+  CassError rc = CASS_OK;
+  CassFuture* future = cass_session_connect(session, cluster);
+
+  cass_future_wait(future);
+  rc = cass_future_error_code(future);
+  if (rc != CASS_OK) {
+    print_error(future);
+  }
+  cass_future_free(future);
+
+  return rc;
+}
+
+CassError execute_query(CassSession* session, const char* query) {
+  CassError rc = CASS_OK;
+  CassFuture* future = NULL;
+  CassStatement* statement = cass_statement_new(query, 0);
+
+  future = cass_session_execute(session, statement);
+  cass_future_wait(future);
+
+  rc = cass_future_error_code(future);
+  if (rc != CASS_OK) {
+    print_error(future);
+  }  
+
+  cass_future_free(future);
+  cass_statement_free(statement);
+  
+  return rc;
+}
+
+CassError prepare_query(CassSession* session, const char* query,
+			const CassPrepared** prepared) {
+  CassError rc = CASS_OK;
+  CassFuture* future = cass_session_prepare(session, query);
+
+  cass_future_wait(future);
+  rc = cass_future_error_code(future);
+  if (rc != CASS_OK) {
+    print_error(future);
+  }
+  else {
+    *prepared = cass_future_get_prepared(future);
+  }
+  cass_future_free(future);
+
+  return rc;
+}
+
+/*****************************************/
+/* Column writers                        */
+/*                                       */
+/* Each appends one non-NULL value of    */
+/* its type to the output.               */
+/*****************************************/
+
+static void write_int64(CsvOut *out, const CassValue *value) {
+  cass_int64_t v;
+  TRYCASS(cass_value_get_int64(value, &v));
+  csv_out_int64(out, v);
+}
+
+static void write_int32(CsvOut *out, const CassValue *value) {
+  cass_int32_t v;
+  TRYCASS(cass_value_get_int32(value, &v));
+  csv_out_int64(out, v);
+}
+
+static void write_double(CsvOut *out, const CassValue *value) {
+  cass_double_t v;
+  TRYCASS(cass_value_get_double(value, &v));
+  csv_out_double(out, v);
+}
+
+static void write_float(CsvOut *out, const CassValue *value) {
+  cass_float_t v;
+  char *p;
+  TRYCASS(cass_value_get_float(value, &v));
+  // Widening to double would print digits the float never had
+  p = csv_out_reserve(out, 32);
+  out->len += snprintf(p, 32, "%.9g", (double)v);
+}
+
+static void write_bool(CsvOut *out, const CassValue *value) {
+  cass_bool_t v;
+  TRYCASS(cass_value_get_bool(value, &v));
+  csv_out_char(out, (v == cass_true) ? '1' : '0');
+}
+
+static void write_text(CsvOut *out, const CassValue *value) {
+  const char *s;
+  size_t len;
+  TRYCASS(cass_value_get_string(value, &s, &len));
+  csv_out_text(out, s, len);
+}
+
+static void write_uuid(CsvOut *out, const CassValue *value) {
+  CassUuid v;
+  char s[CASS_UUID_STRING_LENGTH];
+  TRYCASS(cass_value_get_uuid(value, &v));
+  cass_uuid_string(v, s);
+  csv_out_raw(out, s, strlen(s));
+}
+
+static void write_inet(CsvOut *out, const CassValue *value) {
+  CassInet v;
+  char s[CASS_INET_STRING_LENGTH];
+  TRYCASS(cass_value_get_inet(value, &v));
+  cass_inet_string(v, s);
+  csv_out_raw(out, s, strlen(s));
+}
+
+// The raw bytes, quoted like text if need be
+static void write_bytes(CsvOut *out, const CassValue *value) {
+  const cass_byte_t *b;
+  size_t len;
+  TRYCASS(cass_value_get_bytes(value, &b, &len));
+  csv_out_text(out, (const char *)b, len);
+}
+
+static void write_nothing(CsvOut *out, const CassValue *value) {
+}
+
+// For columns past MAX_FORMAT_COLS: look the type up per value
+static void write_any(CsvOut *out, const CassValue *value) {
+  column_writer(cass_value_type(value))(out, value);
+}
+
+/************************************************************************
+/* column_writer: the writer for values of one type
+/************************************************************************/
+
+ColumnWriter column_writer(CassValueType type) {
+  switch (type) {
+  case CASS_VALUE_TYPE_ASCII:
+  case CASS_VALUE_TYPE_TEXT:
+  case CASS_VALUE_TYPE_VARCHAR:
+    return write_text;
+  case CASS_VALUE_TYPE_BIGINT:
+  case CASS_VALUE_TYPE_COUNTER:
+  case CASS_VALUE_TYPE_TIMESTAMP:
+    return write_int64;
+  case CASS_VALUE_TYPE_INT:
+    return write_int32;
+  case CASS_VALUE_TYPE_FLOAT:
+    return write_float;
+  case CASS_VALUE_TYPE_DOUBLE:
+    return write_double;
+  case CASS_VALUE_TYPE_BOOLEAN:
+    return write_bool;
+  case CASS_VALUE_TYPE_UUID:
+  case CASS_VALUE_TYPE_TIMEUUID:
+    return write_uuid;
+  case CASS_VALUE_TYPE_INET:
+    return write_inet;
+  case CASS_VALUE_TYPE_BLOB:
+  case CASS_VALUE_TYPE_VARINT:
+  case CASS_VALUE_TYPE_LIST:
+  case CASS_VALUE_TYPE_MAP:
+  case CASS_VALUE_TYPE_SET:
+    return write_bytes;
+  default:
+    return write_nothing;
+  }
+}
+
+/************************************************************************
+/* row_format_init: choose the writer for every column of a result
+/************************************************************************/
+
+void row_format_init(RowFormat *format, const CassResult *result) {
+  size_t i;
+
+  format->numCols = cass_result_column_count(result);
+  for (i = 0; (i < format->numCols) && (i < MAX_FORMAT_COLS); i++)
+    format->writers[i] = column_writer(cass_result_column_type(result, i));
+}
+
+/************************************************************************
+/* write_row: append one row as a CSV line; NULL writes an empty field
+/************************************************************************/
+
+void write_row(CsvOut *out, const CassRow *row, const RowFormat *format) {
+  const CassValue *value;
+  size_t i;
+
+  for (i = 0; i < format->numCols; i++) {
+    if (i > 0)
+      csv_out_char(out, ',');
+    value = cass_row_get_column(row, i);
+    if (cass_value_is_null(value))
+      continue;
+    if (i < MAX_FORMAT_COLS)
+      format->writers[i](out, value);
+    else
+      write_any(out, value);
+  }
+  csv_out_char(out, '\n');
+}
@@ -0,0 +1,48 @@
+#ifndef CASSUTIL_H
+#define CASSUTIL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cassandra.h"
+#include "csvout.h"
+
+#define TRYCASS(x)   {   CassError rc = x;			\
+  if (rc != CASS_OK)						\
+    {								\
+      fprintf(stderr, "ERROR: %s\n", cass_error_desc(rc));	\
+      exit(-1);							\
+    }								\
+  }
+
+#define MAX_FORMAT_COLS (100)
+
+/*****************************************/
+/* Typed CSV formatting of result rows   */
+/*                                       */
+/* A writer is chosen per column once    */
+/* from cass_result_column_type, so the  */
+/* per-value work is one indirect call   */
+/* and a direct conversion into the      */
+/* output buffer.                        */
+/*****************************************/
+
+typedef void (*ColumnWriter)(CsvOut *out, const CassValue *value);
+
+typedef struct {
+  size_t       numCols;
+  ColumnWriter writers[MAX_FORMAT_COLS];
+} RowFormat;
+
+void         print_error(CassFuture* future);
+CassCluster* create_cluster(const char* contact_points);
+CassError    connect_session(CassSession* session, const CassCluster* cluster);
+CassError    execute_query(CassSession* session, const char* query);
+CassError    prepare_query(CassSession* session, const char* query,
+			   const CassPrepared** prepared);
+
+ColumnWriter column_writer(CassValueType type);
+void         row_format_init(RowFormat *format, const CassResult *result);
+void         write_row(CsvOut *out, const CassRow *row, const RowFormat *format);
+
+#endif
@@ -0,0 +1,405 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "cassandra.h"
+#include "cassutil.h"
+#include "csvin.h"
+#include "rowgen.h"
+#include "timing.h"
+#include "hist.h"
+
+#define DEFAULT_WINDOW (64)
+#define DEFAULT_BATCH_ROWS (100)
+#define DEFAULT_TABLE "otest.test10"
+
+/*****************************************/
+/* Bulk loader for otest.test10          */
+/*                                       */
+/* Rows of one pkey are contiguous in    */
+/* gen output.  Each run of them, up to  */
+/* batchRows rows, is sent as one        */
+/* unlogged batch of bound INSERTs,      */
+/* which the coordinator applies as a    */
+/* single partition mutation on one      */
+/* replica set.  Up to window writes are */
+/* in flight; the reader blocks when all */
+/* are busy, so the cluster sets the     */
+/* pace instead of the driver's queues.  */
+/* Completion callbacks run on driver    */
+/* I/O threads and share this state      */
+/* under lock.                           */
+/*****************************************/
+typedef struct LoadRequest_ LoadRequest;
+
+typedef struct {
+  CassSession *session;
+  const CassPrepared *prepared;
+  int batchRows;
+  int64_t *pending;            // batchRows rows of NUM_FIELDS values
+  int numPending;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  LoadRequest **idle;          // Slots free to send
+  int numIdle;
+  long long loaded;
+  long long failed;
+  long long writes;
+  Histogram *latency;
+} Loader;
+
+struct LoadRequest_ {
+  Loader *loader;
+  long long sent;
+  int rows;
+};
+
+static struct option long_options[] = {
+  {"window", required_argument, NULL, 'w'},
+  {"batch",  required_argument, NULL, 'b'},
+  {"table",  required_argument, NULL, 'T'},
+  {"gen",    no_argument,       NULL, 'g'},
+  {"dist",   required_argument, NULL, 'd'},
+  {"rng",    required_argument, NULL, 'r'},
+  {NULL,     0,                 NULL, 0}
+};
+
+void usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [options] <contact_points> <csv file>...\n", prog);
+  fprintf(stderr, "       %s [options] --gen <contact_points> <num keys> <rows per key> <offset> <rand seed>\n", prog);
+  fprintf(stderr, "  --window <n>       writes in flight (default %d)\n", DEFAULT_WINDOW);
+  fprintf(stderr, "  --batch <rows>     most rows of one partition per batch (default %d)\n", DEFAULT_BATCH_ROWS);
+  fprintf(stderr, "  --table <name>     table to load (default %s)\n", DEFAULT_TABLE);
+  fprintf(stderr, "  --gen              generate the rows gen would write instead of reading CSV\n");
+  fprintf(stderr, "  --dist <dist>      with --gen, distribution of column values: %s\n", KEYDIST_SPEC_HELP);
+  fprintf(stderr, "  --rng <rng>        with --gen, random generator: %s\n", ROWGEN_RNG_HELP);
+}
+
+CassStatement* bind_row(const CassPrepared *prepared, const int64_t *row) {
+  CassStatement *statement = cass_prepared_bind(prepared);
+  int f;
+
+  for (f = 0; f < NUM_FIELDS; f++)
+    cass_statement_bind_int64(statement, f, (cass_int64_t)row[f]);
+  return statement;
+}
+
+/************************************************************************
+/* on_write: completion callback for a batch or single-row write
+/************************************************************************/
+
+void on_write(CassFuture *future, void *data) {
+  LoadRequest *req = (LoadRequest *)data;
+  Loader *l = req->loader;
+  long long done = now_nanos();
+  bool ok = (CASS_OK == cass_future_error_code(future));
+
+  if (!ok)
+    print_error(future);
+
+  pthread_mutex_lock(&l->lock);
+  hist_record(l->latency, done - req->sent);
+  if (ok)
+    l->loaded += req->rows;
+  else
+    l->failed += req->rows;
+  l->idle[l->numIdle++] = req;
+  pthread_cond_signal(&l->cond);
+  pthread_mutex_unlock(&l->lock);
+}
+
+/************************************************************************
+/* flush_pending: send the pending rows once a slot in the window is
+/*                free
+/*
+/* A single row goes as a plain bound statement, since a batch of one
+/* only adds overhead.
+/************************************************************************/
+
+void flush_pending(Loader *l) {
+  LoadRequest *req;
+  CassFuture *future;
+  int r;
+
+  if (0 == l->numPending)
+    return;
+
+  pthread_mutex_lock(&l->lock);
+  while (0 == l->numIdle)
+    pthread_cond_wait(&l->cond, &l->lock);
+  req = l->idle[--l->numIdle];
+  l->writes++;
+  pthread_mutex_unlock(&l->lock);
+
+  req->rows = l->numPending;
+  req->sent = now_nanos();
+  if (1 == l->numPending) {
+    CassStatement *statement = bind_row(l->prepared, l->pending);
+    future = cass_session_execute(l->session, statement);
+    cass_statement_free(statement);
+  }
+  else {
+    CassBatch *batch = cass_batch_new(CASS_BATCH_TYPE_UNLOGGED);
+    for (r = 0; r < l->numPending; r++) {
+      CassStatement *statement = bind_row(l->prepared, l->pending + r * NUM_FIELDS);
+      TRYCASS(cass_batch_add_statement(batch, statement));
+      cass_statement_free(statement);
+    }
+    future = cass_session_execute_batch(l->session, batch);
+    cass_batch_free(batch);
+  }
+  // The driver keeps the future alive until the callback has run
+  TRYCASS(cass_future_set_callback(future, on_write, req));
+  cass_future_free(future);
+  l->numPending = 0;
+}
+
+// Queue one row, sending the pending batch first if this row starts a
+// new partition or the batch is full
+void add_row(Loader *l, const int64_t *row) {
+  if ((l->numPending > 0) &&
+      ((l->pending[0] != row[0]) || (l->numPending == l->batchRows)))
+    flush_pending(l);
+  memcpy(l->pending + l->numPending * NUM_FIELDS, row, NUM_FIELDS * sizeof(int64_t));
+  l->numPending++;
+}
+
+/************************************************************************
+/* load_generated: generate every chunk in order and queue its rows
+/************************************************************************/
+
+int load_generated(Loader *l, const RowGen *rg) {
+  size_t chunkRows = (size_t)(rg->chunkKeys * rg->rowsperkey);
+  int64_t *fields[NUM_FIELDS];
+  int64_t row[NUM_FIELDS];
+  long long chunk, first, last;
+  ValueStream vs;
+  size_t rows, r;
+  int f;
+
+  for (f = 0; f < NUM_FIELDS; f++) {
+    fields[f] = malloc((chunkRows + 1) * sizeof(int64_t));
+    if (NULL == fields[f]) {
+      fprintf(stderr, "Unable to allocate chunk buffer\n");
+      return -1;
+    }
+  }
+  for (chunk = 0; chunk < rg->numChunks; chunk++) {
+    rowgen_chunk(rg, chunk, &first, &last, &vs);
+    rows = rowgen_fields(rg, fields, first, last, &vs);
+    for (r = 0; r < rows; r++) {
+      for (f = 0; f < NUM_FIELDS; f++)
+	row[f] = fields[f][r];
+      add_row(l, row);
+    }
+  }
+  for (f = 0; f < NUM_FIELDS; f++)
+    free(fields[f]);
+  return 0;
+}
+
+/************************************************************************
+/* load_file: queue every row of a CSV file ("-" for stdin)
+/************************************************************************/
+
+int load_file(Loader *l, CsvIn *in, const char *path) {
+  int64_t row[NUM_FIELDS];
+  int got;
+
+  csv_in_reset(in, (0 == strcmp(path, "-")) ? STDIN_FILENO : open(path, O_RDONLY));
+  if (in->fd < 0) {
+    perror(path);
+    return -1;
+  }
+  while (0 < (got = csv_in_row(in, row, NUM_FIELDS)))
+    add_row(l, row);
+  if (STDIN_FILENO != in->fd)
+    close(in->fd);
+  if (got < 0) {
+    fprintf(stderr, "%s:%lld: expected %d integers\n", path, in->line, NUM_FIELDS);
+    return -1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  char *contact_points;
+  char *table = DEFAULT_TABLE;
+  char *dist = NULL;
+  char *rng = NULL;
+  char query[1024];
+  int window = DEFAULT_WINDOW;
+  int batchRows = DEFAULT_BATCH_ROWS;
+  bool fromGen = false;
+  RowGen rg;
+  char *endptr;
+  size_t len;
+  int opt, f, w;
+  int status = 0;
+
+  while (-1 != (opt = getopt_long(argc, argv, "w:b:T:gd:r:", long_options, NULL))) {
+    switch (opt) {
+    case 'w':
+      window = atoi(optarg);
+      if (window < 1) {
+	usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'b':
+      batchRows = atoi(optarg);
+      if (batchRows < 1) {
+	usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'T':
+      table = optarg;
+      break;
+    case 'g':
+      fromGen = true;
+      break;
+    case 'd':
+      dist = optarg;
+      break;
+    case 'r':
+      rng = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (fromGen ? (argc - optind != 5) : (argc - optind < 2)) {
+    usage(argv[0]);
+    return 1;
+  }
+  contact_points = argv[optind];
+  if (fromGen) {
+    long long numkeys = strtoll(argv[optind + 1], &endptr, 10);
+    long long rowsperkey = strtoll(argv[optind + 2], &endptr, 10);
+    long long offset = strtoll(argv[optind + 3], &endptr, 10) * numkeys;
+    int seed = atoi(argv[optind + 4]);
+    if ((0 != rowgen_init(&rg, numkeys, rowsperkey, offset, seed, dist)) ||
+	(0 != rowgen_set_rng(&rg, rng))) {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  len = snprintf(query, sizeof(query), "INSERT INTO %s (", table);
+  for (f = 0; f < NUM_FIELDS; f++)
+    len += snprintf(query + len, sizeof(query) - len, "%s%s", (f > 0) ? ", " : "", fieldNames[f]);
+  len += snprintf(query + len, sizeof(query) - len, ") VALUES (");
+  for (f = 0; f < NUM_FIELDS; f++)
+    len += snprintf(query + len, sizeof(query) - len, "%s?", (f > 0) ? ", " : "");
+  len += snprintf(query + len, sizeof(query) - len, ")");
+  if (len >= sizeof(query)) {
+    fprintf(stderr, "Table name too long\n");
+    return 1;
+  }
+
+  CassCluster* cluster = create_cluster(contact_points);
+  CassSession* session = cass_session_new();
+  CassFuture* close_future = NULL;
+
+  if (connect_session(session, cluster) != CASS_OK) {
+    cass_cluster_free(cluster);
+    cass_session_free(session);
+    return -1;
+  }
+
+  const CassPrepared* prepared = NULL;
+  if (prepare_query(session, query, &prepared) != CASS_OK) {
+    cass_session_free(session);
+    cass_cluster_free(cluster);
+    return -1;
+  }
+
+  Loader *l = calloc(1, sizeof(Loader));
+  LoadRequest *reqs = calloc(window, sizeof(LoadRequest));
+  if ((NULL == l) || (NULL == reqs)) {
+    fprintf(stderr, "Unable to allocate a window of %d writes\n", window);
+    return -1;
+  }
+  l->session = session;
+  l->prepared = prepared;
+  l->batchRows = batchRows;
+  l->pending = malloc((size_t)batchRows * NUM_FIELDS * sizeof(int64_t));
+  l->idle = calloc(window, sizeof(LoadRequest *));
+  l->latency = malloc(sizeof(Histogram));
+  if ((NULL == l->pending) || (NULL == l->idle) || (NULL == l->latency)) {
+    fprintf(stderr, "Unable to allocate loader\n");
+    return -1;
+  }
+  hist_init(l->latency);
+  pthread_mutex_init(&l->lock, NULL);
+  pthread_cond_init(&l->cond, NULL);
+  for (w = 0; w < window; w++) {
+    reqs[w].loader = l;
+    l->idle[l->numIdle++] = &reqs[w];
+  }
+
+  long long t0 = now_nanos();
+  if (fromGen) {
+    status = load_generated(l, &rg);
+  }
+  else {
+    CsvIn in;
+    if (0 != csv_in_init(&in, -1, CSV_IN_DEFAULT_SIZE))
+      return -1;
+    for (f = optind + 1; (f < argc) && (0 == status); f++)
+      status = load_file(l, &in, argv[f]);
+    csv_in_free(&in);
+  }
+  flush_pending(l);
+
+  // Wait for the window to drain
+  pthread_mutex_lock(&l->lock);
+  while (l->numIdle < window)
+    pthread_cond_wait(&l->cond, &l->lock);
+  pthread_mutex_unlock(&l->lock);
+  double elapsed = (double)(now_nanos() - t0) / NANOS_PER_SEC;
+
+  fprintf(stderr, "total: %lld rows in %.3f s, %.1f rows/s\n",
+	  l->loaded, elapsed, (elapsed > 0) ? l->loaded / elapsed : 0.0);
+  fprintf(stderr, "writes: %lld (%.1f rows each), %.1f writes/s\n",
+	  l->writes, (l->writes > 0) ? (double)(l->loaded + l->failed) / l->writes : 0.0,
+	  (elapsed > 0) ? l->writes / elapsed : 0.0);
+  if (l->failed > 0) {
+    fprintf(stderr, "failed: %lld rows\n", l->failed);
+    status = -1;
+  }
+  fprintf(stderr, "window: %d writes in flight, batches of up to %d rows\n", window, batchRows);
+  if (fromGen) {
+    fprintf(stderr, "rng: ");
+    rowgen_describe_rng(stderr, &rg);
+    fprintf(stderr, "\n");
+  }
+  hist_print(stderr, "latency", l->latency);
+
+  pthread_cond_destroy(&l->cond);
+  pthread_mutex_destroy(&l->lock);
+  free(l->latency);
+  free(l->idle);
+  free(l->pending);
+  free(l);
+  free(reqs);
+  cass_prepared_free(prepared);
+
+  close_future = cass_session_close(session);
+  cass_future_wait(close_future);
+  cass_future_free(close_future);
+
+  cass_cluster_free(cluster);
+  cass_session_free(session);
+
+  return (0 == status) ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "colpack.h"
+#include "csvout.h"
+#include "rowgen.h"
+#include "timing.h"
+
+typedef struct {
+  const uint8_t *data;
+  size_t len;
+  size_t pos;
+  int64_t values[COLPACK_BLOCK_ROWS];
+} PackedColumn;
+
+// Map <prefix>.<name>.pk; returns -1 on error
+static int open_column(PackedColumn *col, const char *prefix, const char *name) {
+  char path[4096];
+  struct stat st;
+  int fd;
+
+  snprintf(path, sizeof(path), "%s.%s.pk", prefix, name);
+  fd = open(path, O_RDONLY);
+  if ((fd < 0) || (0 != fstat(fd, &st))) {
+    perror(path);
+    return -1;
+  }
+  col->len = st.st_size;
+  col->pos = 0;
+  col->data = NULL;
+  if (col->len > 0) {
+    col->data = mmap(NULL, col->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == col->data) {
+      perror(path);
+      close(fd);
+      return -1;
+    }
+    madvise((void *)col->data, col->len, MADV_SEQUENTIAL);
+  }
+  close(fd);
+  return 0;
+}
+
+/************************************************************************
+/* colcat: decode a packed dataset written by gen --format packed and
+/*         print it as the same CSV gen would have written, or with
+/*         silent just decode and count the rows
+/************************************************************************/
+
+int main(int argc, char **argv) {
+  PackedColumn *cols;
+  CsvOut out;
+  bool silent = false;
+  long long rows = 0;
+  long long t0;
+  size_t n, count, i;
+  int f;
+
+  if ((argc != 2) && (argc != 3)) {
+    fprintf(stderr, "Usage: %s <prefix> [silent]\n", argv[0]);
+    return 1;
+  }
+  if (3 == argc) {
+    if (0 != strncmp("silent", argv[2], 6)) {
+      fprintf(stderr, "Usage: %s <prefix> [silent]\n", argv[0]);
+      return 1;
+    }
+    silent = true;
+  }
+
+  cols = malloc(NUM_FIELDS * sizeof(PackedColumn));
+  if (NULL == cols) {
+    fprintf(stderr, "Unable to allocate columns\n");
+    return 1;
+  }
+  for (f = 0; f < NUM_FIELDS; f++) {
+    if (0 != open_column(&cols[f], argv[1], fieldNames[f]))
+      return 1;
+  }
+  if (!silent && (0 != csv_out_init(&out, STDOUT_FILENO, CSV_OUT_DEFAULT_SIZE)))
+    return 1;
+
+  t0 = now_nanos();
+  while (cols[0].pos < cols[0].len) {
+    // Blocks line up across columns: decode one from each
+    for (f = 0; f < NUM_FIELDS; f++) {
+      PackedColumn *col = &cols[f];
+      size_t used = colpack_decode(col->data + col->pos, col->len - col->pos,
+				   col->values, &count);
+      if ((0 == used) || ((f > 0) && (count != n))) {
+	fprintf(stderr, "%s.%s.pk: bad block at offset %zu\n",
+		argv[1], fieldNames[f], col->pos);
+	return 1;
+      }
+      col->pos += used;
+      n = count;
+    }
+    if (!silent) {
+      for (i = 0; i < n; i++) {
+	csv_out_int64(&out, cols[0].values[i]);
+	for (f = 1; f < NUM_FIELDS; f++) {
+	  csv_out_char(&out, ',');
+	  csv_out_int64(&out, cols[f].values[i]);
+	}
+	csv_out_char(&out, '\n');
+      }
+    }
+    rows += n;
+  }
+  double elapsed = (double)(now_nanos() - t0) / NANOS_PER_SEC;
+
+  if (!silent)
+    csv_out_free(&out);
+  fprintf(stderr, "%lld rows in %.3f s, %.1f rows/s (%s unpack)\n", rows, elapsed,
+	  (elapsed > 0) ? rows / elapsed : 0.0, colpack_unpack_impl());
+
+  return 0;
+}
@@ -0,0 +1,234 @@
+#include <string.h>
+#include <endian.h>
+
+#include "colpack.h"
+
+// The AVX2 kernel is only built on little-endian x86; elsewhere
+// colpack_unpack always uses the scalar code
+#if defined(__x86_64__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define COLPACK_AVX2
+#include <immintrin.h>
+#endif
+
+// Bytes of packed data for n values of the given width, padded
+static size_t packed_size(unsigned bits, size_t n) {
+  if (0 == bits)
+    return 0;
+  return ((n * bits + 63) / 64) * 8 + 8;
+}
+
+static unsigned width_of(uint64_t v) {
+  return (0 == v) ? 0 : 64 - __builtin_clzll(v);
+}
+
+/************************************************************************
+/* colpack_pack: pack the low bits of n values into a padded bit stream
+/************************************************************************/
+
+void colpack_pack(const uint64_t *in, unsigned bits, size_t n, uint8_t *out) {
+  size_t words = packed_size(bits, n) / 8;
+  uint64_t w[2];
+  size_t i;
+
+  memset(out, 0, words * 8);
+  for (i = 0; i < n; i++) {
+    size_t pos = i * bits;
+    size_t word = pos >> 6;
+    unsigned shift = pos & 63;
+
+    memcpy(w, out + word * 8, (shift + bits > 64) ? 16 : 8);
+    w[0] = le64toh(w[0]) | (in[i] << shift);
+    w[0] = htole64(w[0]);
+    if (shift + bits > 64) {
+      w[1] = le64toh(w[1]) | (in[i] >> (64 - shift));
+      w[1] = htole64(w[1]);
+    }
+    memcpy(out + word * 8, w, (shift + bits > 64) ? 16 : 8);
+  }
+}
+
+/*****************************************/
+/* Unpack kernels                        */
+/*                                       */
+/* Value i starts at bit i*bits; load    */
+/* the 8 bytes holding its first bit,    */
+/* shift, and mask.  That covers widths  */
+/* up to 57 bits; wider values take two  */
+/* loads.  The AVX2 kernel does four     */
+/* values per step with a gather.        */
+/*****************************************/
+
+static inline uint64_t load_le64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return le64toh(v);
+}
+
+static void unpack_scalar(const uint8_t *in, unsigned bits, size_t n, uint64_t *out,
+			  size_t start) {
+  uint64_t mask = (bits == 64) ? ~0ULL : ((1ULL << bits) - 1);
+  size_t i;
+
+  for (i = start; i < n; i++) {
+    size_t pos = i * bits;
+    unsigned shift = pos & 7;
+    uint64_t v = load_le64(in + (pos >> 3)) >> shift;
+
+    if (shift + bits > 64)
+      v |= (uint64_t)in[(pos >> 3) + 8] << (64 - shift);
+    out[i] = v & mask;
+  }
+}
+
+#ifdef COLPACK_AVX2
+__attribute__((target("avx2")))
+static void unpack_avx2(const uint8_t *in, unsigned bits, size_t n, uint64_t *out) {
+  const __m256i mask = _mm256_set1_epi64x((long long)((1ULL << bits) - 1));
+  const __m256i seven = _mm256_set1_epi64x(7);
+  const __m256i stride = _mm256_set1_epi64x(4LL * bits);
+  __m256i pos = _mm256_setr_epi64x(0, bits, 2LL * bits, 3LL * bits);
+  size_t i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m256i byte = _mm256_srli_epi64(pos, 3);
+    __m256i shift = _mm256_and_si256(pos, seven);
+    __m256i v = _mm256_i64gather_epi64((const long long *)in, byte, 1);
+
+    v = _mm256_and_si256(_mm256_srlv_epi64(v, shift), mask);
+    _mm256_storeu_si256((__m256i *)(out + i), v);
+    pos = _mm256_add_epi64(pos, stride);
+  }
+  unpack_scalar(in, bits, n, out, i);
+}
+
+static int have_avx2(void) {
+  static int cached = -1;
+
+  if (cached < 0) {
+    __builtin_cpu_init();
+    cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+  }
+  return cached;
+}
+#else
+static int have_avx2(void) {
+  return 0;
+}
+#endif
+
+/************************************************************************
+/* colpack_unpack: unpack n values of the given width, with the widest
+/*                 kernel the CPU supports
+/************************************************************************/
+
+void colpack_unpack(const uint8_t *in, unsigned bits, size_t n, uint64_t *out) {
+  if (0 == bits) {
+    memset(out, 0, n * sizeof(uint64_t));
+    return;
+  }
+#ifdef COLPACK_AVX2
+  if ((bits <= 57) && have_avx2()) {
+    unpack_avx2(in, bits, n, out);
+    return;
+  }
+#endif
+  unpack_scalar(in, bits, n, out, 0);
+}
+
+const char *colpack_unpack_impl(void) {
+  return have_avx2() ? "avx2" : "scalar";
+}
+
+/************************************************************************
+/* colpack_encode: encode n values (at most COLPACK_BLOCK_ROWS) as one
+/*                 block; returns the bytes written to out, which must
+/*                 hold COLPACK_BLOCK_BOUND(n)
+/************************************************************************/
+
+size_t colpack_encode(const int64_t *in, size_t n, int encoding, uint8_t *out) {
+  uint64_t packed[COLPACK_BLOCK_ROWS];
+  ColPackHeader h;
+  uint64_t maxp = 0;
+  int64_t base = 0, step = 0;
+  size_t i;
+
+  if (n > 0)
+    base = in[0];
+  if (COLPACK_DELTA == encoding) {
+    for (i = 1; i < n; i++) {
+      int64_t d = (int64_t)((uint64_t)in[i] - (uint64_t)in[i - 1]);
+      if ((1 == i) || (d < step))
+	step = d;
+    }
+    packed[0] = 0;
+    for (i = 1; i < n; i++) {
+      packed[i] = (uint64_t)in[i] - (uint64_t)in[i - 1] - (uint64_t)step;
+      if (packed[i] > maxp)
+	maxp = packed[i];
+    }
+  }
+  else {
+    encoding = COLPACK_FOR;
+    for (i = 1; i < n; i++) {
+      if (in[i] < base)
+	base = in[i];
+    }
+    for (i = 0; i < n; i++) {
+      packed[i] = (uint64_t)in[i] - (uint64_t)base;
+      if (packed[i] > maxp)
+	maxp = packed[i];
+    }
+  }
+
+  memset(&h, 0, sizeof(h));
+  h.count = htole32((uint32_t)n);
+  h.encoding = (uint8_t)encoding;
+  h.bits = (uint8_t)width_of(maxp);
+  h.base = (int64_t)htole64((uint64_t)base);
+  h.step = (int64_t)htole64((uint64_t)step);
+  memcpy(out, &h, sizeof(h));
+  colpack_pack(packed, h.bits, n, out + sizeof(h));
+  return sizeof(h) + packed_size(h.bits, n);
+}
+
+/************************************************************************
+/* colpack_decode: decode the block at in into out (room for
+/*                 COLPACK_BLOCK_ROWS values)
+/*
+/* Sets *count to the number of values and returns the bytes consumed,
+/* or 0 if the block is malformed or runs past avail.
+/************************************************************************/
+
+size_t colpack_decode(const uint8_t *in, size_t avail, int64_t *out, size_t *count) {
+  ColPackHeader h;
+  size_t n, len, i;
+  int64_t base, step;
+
+  if (avail < sizeof(h))
+    return 0;
+  memcpy(&h, in, sizeof(h));
+  n = le32toh(h.count);
+  base = (int64_t)le64toh((uint64_t)h.base);
+  step = (int64_t)le64toh((uint64_t)h.step);
+  if ((n > COLPACK_BLOCK_ROWS) || (h.bits > 64) || (h.encoding > COLPACK_DELTA))
+    return 0;
+  len = sizeof(h) + packed_size(h.bits, n);
+  if (len > avail)
+    return 0;
+
+  colpack_unpack(in + sizeof(h), h.bits, n, (uint64_t *)out);
+  if (COLPACK_DELTA == h.encoding) {
+    uint64_t v = (uint64_t)base;
+    for (i = 0; i < n; i++) {
+      if (i > 0)
+	v += (uint64_t)step + (uint64_t)out[i];
+      out[i] = (int64_t)v;
+    }
+  }
+  else {
+    for (i = 0; i < n; i++)
+      out[i] = (int64_t)((uint64_t)out[i] + (uint64_t)base);
+  }
+  *count = n;
+  return len;
+}
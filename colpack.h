@@ -0,0 +1,52 @@
+#ifndef COLPACK_H
+#define COLPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*****************************************/
+/* Bit-packed int64 column blocks        */
+/*                                       */
+/* A column is a sequence of blocks of   */
+/* up to COLPACK_BLOCK_ROWS values, each */
+/* a header followed by the values       */
+/* packed LSB-first at a fixed width:    */
+/*                                       */
+/*   FOR:   v[i] = base + p[i]           */
+/*   DELTA: v[0] = base,                 */
+/*          v[i] = v[i-1] + step + p[i]  */
+/*                                       */
+/* base and step are the smallest value  */
+/* and delta, so p[i] >= 0 and the width */
+/* is just enough for the largest p[i].  */
+/* Everything is little-endian.  The     */
+/* packed bits are padded so a decoder   */
+/* may load 8 bytes at any value's       */
+/* first byte.                           */
+/*****************************************/
+
+#define COLPACK_BLOCK_ROWS (4096)
+
+#define COLPACK_FOR   (0)
+#define COLPACK_DELTA (1)
+
+typedef struct {
+  uint32_t count;
+  uint8_t  encoding;
+  uint8_t  bits;
+  uint16_t reserved;
+  int64_t  base;
+  int64_t  step;
+} ColPackHeader;
+
+// Largest encoding of n values (n <= COLPACK_BLOCK_ROWS)
+#define COLPACK_BLOCK_BOUND(n) (sizeof(ColPackHeader) + (n) * 8 + 16)
+
+size_t colpack_encode(const int64_t *in, size_t n, int encoding, uint8_t *out);
+size_t colpack_decode(const uint8_t *in, size_t avail, int64_t *out, size_t *count);
+
+void colpack_pack(const uint64_t *in, unsigned bits, size_t n, uint8_t *out);
+void colpack_unpack(const uint8_t *in, unsigned bits, size_t n, uint64_t *out);
+const char *colpack_unpack_impl(void);
+
+#endif
@@ -1,152 +1,570 @@
+#define _GNU_SOURCE
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <pthread.h>
 
 #include "cassandra.h"
+#include "csvout.h"
+#include "cassutil.h"
+#include "timing.h"
+#include "groupmax.h"
 
-#define TRYCASS(x)   {   CassError rc = x;			\
-  if (rc != CASS_OK)						\
-    {								\
-      fprintf(stderr, "ERROR: %s\n", cass_error_desc(rc));	\
-      exit(-1);							\
-    }								\
+#define DEFAULT_PAGE_SIZE (5000)
+#define DEFAULT_SCAN_WINDOW (32)
+#define DEFAULT_PARTITION_KEY "pkey"
+
+// Most formatted output a scan holds for the writer before ranges stop
+// asking for more pages
+#define SCAN_MAX_QUEUED (64 << 20)
+
+typedef struct Scan_ Scan;
+
+void scan_hand_off(Scan *scan, CsvOut *out);
+
+/************************************************************************
+/* consume_page: count the rows of one result page, writing them as CSV
+/*               unless silent
+/*
+/* In a scan (scan not NULL) the rows are not written here: whole rows
+/* are handed to the scan's writer a buffer at a time.
+/************************************************************************/
+
+long consume_page(const CassResult *result, bool silent, CsvOut *out,
+		  Scan *scan) {
+  RowFormat format;
+  long numResults = 0;
+  CassIterator* iterator = cass_iterator_from_result(result);
+
+  if (!silent)
+    row_format_init(&format, result);
+  while (cass_true == cass_iterator_next(iterator)) {
+    if (!silent) {
+      if ((NULL != scan) && (out->len > out->cap / 2))
+	scan_hand_off(scan, out);
+      write_row(out, cass_iterator_get_row(iterator), &format);
+    }
+    numResults++;
   }
+  cass_iterator_free(iterator);
 
-void print_error(CassFuture* future) {
-  const char* message;
-  size_t message_length;
-  cass_future_error_message(future, &message, &message_length);
-  fprintf(stderr, "Error: %.*s\n", (int)message_length, message);
+  if (!silent && (NULL != scan))
+    scan_hand_off(scan, out);
+  return numResults;
 }
 
-CassCluster* create_cluster(const char* contact_points) {
-  CassCluster* cluster = cass_cluster_new();
-  cass_cluster_set_contact_points(cluster, contact_points);
-  return cluster;
+/************************************************************************
+/* get_int64: read an integer column as int64; false for NULL
+/************************************************************************/
+
+bool get_int64(const CassValue *value, int64_t *v) {
+  cass_int64_t val_int64;
+  cass_int32_t val_int32;
+
+  if (cass_value_is_null(value))
+    return false;
+  switch (cass_value_type(value)) {
+  case CASS_VALUE_TYPE_BIGINT:
+  case CASS_VALUE_TYPE_COUNTER:
+  case CASS_VALUE_TYPE_TIMESTAMP:
+    TRYCASS(cass_value_get_int64(value, &val_int64));
+    *v = val_int64;
+    return true;
+  case CASS_VALUE_TYPE_INT:
+    TRYCASS(cass_value_get_int32(value, &val_int32));
+    *v = val_int32;
+    return true;
+  default:
+    fprintf(stderr, "--groupmax needs integer columns\n");
+    exit(-1);
+  }
 }
 
-CassError connect_session(CassSession* session, const CassCluster* cluster) {
-  CassError rc = CASS_OK;
-  CassFuture* future = cass_session_connect(session, cluster);
+/************************************************************************
+/* aggregate_page: fold one result page into a grouped MAX
+/*
+/* Rows are (key, value): the first column groups and the second is
+/* maximized.  A single-column result is one group (key 0).  Rows with
+/* a NULL key or value are skipped, as MAX skips NULLs.
+/************************************************************************/
 
-  cass_future_wait(future);
-  rc = cass_future_error_code(future);
-  if (rc != CASS_OK) {
-    print_error(future);
+long aggregate_page(const CassResult *result, GroupMax *g) {
+  size_t nCols = cass_result_column_count(result);
+  long numResults = 0;
+  int64_t key = 0;
+  int64_t val;
+  CassIterator* iterator = cass_iterator_from_result(result);
+
+  while (cass_true == cass_iterator_next(iterator)) {
+    const CassRow* row = cass_iterator_get_row(iterator);
+    numResults++;
+    if (nCols > 1) {
+      if (!get_int64(cass_row_get_column(row, 0), &key) ||
+	  !get_int64(cass_row_get_column(row, 1), &val))
+	continue;
+    }
+    else if (!get_int64(cass_row_get_column(row, 0), &val))
+      continue;
+    if (0 != group_max_add(g, key, val)) {
+      fprintf(stderr, "Unable to grow group table\n");
+      exit(-1);
+    }
   }
+  cass_iterator_free(iterator);
+
+  return numResults;
+}
+
+/************************************************************************
+/* add_token_range: restrict a query to one token range
+/*
+/* Returns a new query with "token(key) > ? AND token(key) <= ?" added
+/* to its WHERE clause (or as a new WHERE clause), ahead of any
+/* GROUP BY, ORDER BY, LIMIT or ALLOW FILTERING.
+/************************************************************************/
+
+char *add_token_range(const char *query, const char *key) {
+  static const char *tails[] = {" GROUP BY", " ORDER BY", " LIMIT", " ALLOW FILTERING", NULL};
+  size_t qlen = strlen(query);
+  size_t split = qlen;
+  const char *p;
+  char *newQuery;
+  int i;
+
+  // Drop a trailing semicolon
+  while ((split > 0) && ((query[split - 1] == ';') || (query[split - 1] == ' ')))
+    split--;
+  for (i = 0; NULL != tails[i]; i++) {
+    p = strcasestr(query, tails[i]);
+    if ((NULL != p) && ((size_t)(p - query) < split))
+      split = p - query;
+  }
+  p = strcasestr(query, " WHERE ");
+  newQuery = malloc(qlen + 2 * strlen(key) + 64);
+  if (NULL == newQuery)
+    return NULL;
+  sprintf(newQuery, "%.*s %s token(%s) > ? AND token(%s) <= ?%s",
+	  (int)split, query,
+	  ((NULL != p) && ((size_t)(p - query) < split)) ? "AND" : "WHERE",
+	  key, key, query + split);
+  return newQuery;
+}
+
+/*****************************************/
+/* Parallel token-range scan             */
+/*                                       */
+/* The Murmur3 ring is cut into numRanges*/
+/* equal subranges, and up to window of  */
+/* them are read at once, each paging    */
+/* through its range from driver         */
+/* callbacks.  Rows are formatted into a */
+/* per-I/O-thread buffer, or with        */
+/* groupMax folded into a per-I/O-thread */
+/* table that is merged at the end.      */
+/*                                       */
+/* The callbacks run on the driver's I/O */
+/* threads, so they never write(2): full */
+/* buffers are queued for the main       */
+/* thread to write.  If stdout falls     */
+/* SCAN_MAX_QUEUED behind, ranges park   */
+/* instead of asking for their next page */
+/* and the writer restarts them once it  */
+/* has caught up.                        */
+/*****************************************/
+typedef struct ScanRange_ ScanRange;
+
+typedef struct OutBuf_ {
+  struct OutBuf_ *next;
+  char *buf;
+  size_t len;
+  size_t cap;
+} OutBuf;
+
+struct Scan_ {
+  CassSession *session;
+  const CassPrepared *prepared;
+  int pageSize;
+  bool silent;
+  bool groupMax;
+  cass_int64_t *bounds;        // numRanges + 1 boundaries
+  int numRanges;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int nextRange;
+  int active;
+  long rows;
+  long pages;
+  bool failed;
+  GroupMax **tables;           // One per I/O thread that ran a callback
+  int numTables;
+  size_t numCols;
+  OutBuf *queue;               // Formatted rows waiting to be written
+  OutBuf **queueTail;
+  OutBuf *spare;               // Written buffers for reuse
+  size_t queued;               // Bytes in queue
+  int parked;                  // Ranges waiting for the writer
+};
+
+struct ScanRange_ {
+  Scan *scan;
+  CassStatement *statement;
+  int pending;                 // Pages requested but not yet counted
+  bool last;                   // The final page has arrived
+  bool parked;                 // Next page not requested yet
+};
+
+static __thread CsvOut scanOut;
+static __thread GroupMax *scanAgg;
+
+// This thread's group table, registered with the scan on first use
+GroupMax *scan_table(Scan *scan) {
+  GroupMax **tables;
+
+  if (NULL != scanAgg)
+    return scanAgg;
+  scanAgg = malloc(sizeof(GroupMax));
+  if ((NULL == scanAgg) || (0 != group_max_init(scanAgg, GROUP_MAX_DEFAULT_SIZE))) {
+    fprintf(stderr, "Unable to allocate group table\n");
+    exit(-1);
+  }
+  pthread_mutex_lock(&scan->lock);
+  tables = realloc(scan->tables, (scan->numTables + 1) * sizeof(GroupMax *));
+  if (NULL == tables) {
+    fprintf(stderr, "Unable to allocate group table\n");
+    exit(-1);
+  }
+  scan->tables = tables;
+  scan->tables[scan->numTables++] = scanAgg;
+  pthread_mutex_unlock(&scan->lock);
+  return scanAgg;
+}
+
+/************************************************************************
+/* scan_hand_off: queue the rows in out for the writer and give out an
+/*                empty buffer
+/************************************************************************/
+
+void scan_hand_off(Scan *scan, CsvOut *out) {
+  OutBuf *b;
+
+  if (0 == out->len)
+    return;
+  pthread_mutex_lock(&scan->lock);
+  b = scan->spare;
+  if (NULL != b)
+    scan->spare = b->next;
+  pthread_mutex_unlock(&scan->lock);
+  if (NULL == b) {
+    b = malloc(sizeof(OutBuf));
+    if ((NULL == b) || (NULL == (b->buf = malloc(CSV_OUT_DEFAULT_SIZE)))) {
+      fprintf(stderr, "Unable to allocate output buffer\n");
+      exit(-1);
+    }
+    b->cap = CSV_OUT_DEFAULT_SIZE;
+  }
+
+  // Swap buffers: b takes the rows, out takes b's empty buffer
+  {
+    char *empty = b->buf;
+    size_t cap = b->cap;
+
+    b->buf = out->buf;
+    b->len = out->len;
+    b->cap = out->cap;
+    b->next = NULL;
+    out->buf = empty;
+    out->len = 0;
+    out->cap = cap;
+  }
+
+  pthread_mutex_lock(&scan->lock);
+  *scan->queueTail = b;
+  scan->queueTail = &b->next;
+  scan->queued += b->len;
+  pthread_cond_signal(&scan->cond);
+  pthread_mutex_unlock(&scan->lock);
+}
+
+void on_scan_page(CassFuture *future, void *data);
+
+void scan_execute(ScanRange *range) {
+  CassFuture *future;
+
+  pthread_mutex_lock(&range->scan->lock);
+  range->pending++;
+  pthread_mutex_unlock(&range->scan->lock);
+  future = cass_session_execute(range->scan->session, range->statement);
+  TRYCASS(cass_future_set_callback(future, on_scan_page, range));
   cass_future_free(future);
+}
 
-  return rc;
+// Start reading range r from the top
+void scan_start(ScanRange *range, int r) {
+  Scan *scan = range->scan;
+
+  range->last = false;
+  range->statement = cass_prepared_bind(scan->prepared);
+  TRYCASS(cass_statement_bind_int64(range->statement, 0, scan->bounds[r]));
+  TRYCASS(cass_statement_bind_int64(range->statement, 1, scan->bounds[r + 1]));
+  TRYCASS(cass_statement_set_paging_size(range->statement, scan->pageSize));
+  scan_execute(range);
 }
 
-CassError execute_query(CassSession* session, const char* query) {
-  CassError rc = CASS_OK;
-  CassFuture* future = NULL;
-  CassStatement* statement = cass_statement_new(query, 0);
+/************************************************************************
+/* on_scan_page: consume one page of a range
+/*
+/* The request for the following page goes out before this one is
+/* consumed, so the next callback for the range may finish first.  Once
+/* the last page has arrived and every page has been counted, the slot
+/* moves on to the next unread range, or retires if there are none left.
+/************************************************************************/
 
-  future = cass_session_execute(session, statement);
-  cass_future_wait(future);
+void on_scan_page(CassFuture *future, void *data) {
+  ScanRange *range = (ScanRange *)data;
+  Scan *scan = range->scan;
+  const CassResult *result = NULL;
+  bool more = false;
+  long numResults = 0;
+  size_t nCols = 0;
+  int next = -1;
 
-  rc = cass_future_error_code(future);
-  if (rc != CASS_OK) {
+  if (CASS_OK != cass_future_error_code(future)) {
     print_error(future);
-  }  
+  }
+  else {
+    result = cass_future_get_result(future);
+    nCols = cass_result_column_count(result);
+    more = cass_result_has_more_pages(result);
+    if (more) {
+      bool park;
 
-  cass_future_free(future);
-  cass_statement_free(statement);
-  
-  return rc;
+      TRYCASS(cass_statement_set_paging_state(range->statement, result));
+      pthread_mutex_lock(&scan->lock);
+      park = (scan->queued > SCAN_MAX_QUEUED);
+      if (park) {
+	range->parked = true;
+	scan->parked++;
+      }
+      pthread_mutex_unlock(&scan->lock);
+      if (!park)
+	scan_execute(range);
+    }
+    if (scan->groupMax) {
+      numResults = aggregate_page(result, scan_table(scan));
+    }
+    else {
+      if (!scan->silent && (NULL == scanOut.buf)) {
+	// Memory only: a row too big for the buffer grows it rather
+	// than being written from this thread
+	if (0 != csv_out_init(&scanOut, -1, CSV_OUT_DEFAULT_SIZE))
+	  exit(-1);
+      }
+      numResults = consume_page(result, scan->silent, &scanOut, scan);
+    }
+    cass_result_free(result);
+  }
+
+  pthread_mutex_lock(&scan->lock);
+  scan->rows += numResults;
+  scan->pages++;
+  if (NULL == result)
+    scan->failed = true;
+  else
+    scan->numCols = nCols;
+  if (!more)
+    range->last = true;
+  if ((--range->pending > 0) || !range->last) {
+    pthread_mutex_unlock(&scan->lock);
+    return;
+  }
+
+  cass_statement_free(range->statement);
+  range->statement = NULL;
+  if (scan->nextRange < scan->numRanges)
+    next = scan->nextRange++;
+  else
+    scan->active--;
+  pthread_cond_signal(&scan->cond);
+  pthread_mutex_unlock(&scan->lock);
+
+  if (next >= 0)
+    scan_start(range, next);
 }
 
-char* get_column_as_string(const CassValue *value, char* buf, int bufsize) {
-  buf[0] = '\0';
-  const char *tbuf;
-  char *tbuf2;
-  size_t tbufsize;
-  CassValueType vtype = cass_value_type(value);
-  cass_int64_t val_int64;
-  cass_int32_t val_int32;
-  cass_float_t val_float;
-  cass_double_t val_double;
-  cass_bool_t val_bool;
-  CassUuid val_uuid;
-  CassInet val_inet;
-  const cass_byte_t *val_byte;
-  
-  switch (vtype) {
-  case CASS_VALUE_TYPE_ASCII:
-  case CASS_VALUE_TYPE_TEXT:
-  case CASS_VALUE_TYPE_VARCHAR:
-    TRYCASS(cass_value_get_string(value, &tbuf, &tbufsize));
-    if (tbufsize < bufsize - 1) {
-      memcpy(buf, tbuf, tbufsize);
-      buf[tbufsize] = '\0';
-    }
-    break;
-  case CASS_VALUE_TYPE_BIGINT:
-  case CASS_VALUE_TYPE_TIMESTAMP:
-    TRYCASS(cass_value_get_int64(value, &val_int64));
-    sprintf(buf, "%lld", (long long)val_int64);
-    break;
-  case CASS_VALUE_TYPE_INT:
-    TRYCASS(cass_value_get_int32(value, &val_int32));
-    sprintf(buf, "%d", (int)val_int32);
-    break;
-  case CASS_VALUE_TYPE_FLOAT:
-    TRYCASS(cass_value_get_float(value, &val_float));
-    sprintf(buf, "%f", (float)val_float);
-    break;
-  case CASS_VALUE_TYPE_DOUBLE:
-    TRYCASS(cass_value_get_double(value, &val_double));
-    sprintf(buf, "%f", (double)val_double);
-    break;
-  case CASS_VALUE_TYPE_BOOLEAN:
-    TRYCASS(cass_value_get_bool(value, &val_bool));
-    sprintf(buf, "%s", (val_bool == cass_true) ? "1" : "0");
-    break;
-  case CASS_VALUE_TYPE_UUID:
-  case CASS_VALUE_TYPE_TIMEUUID:
-    TRYCASS(cass_value_get_uuid(value, &val_uuid));
-    cass_uuid_string(val_uuid, tbuf2);
-    sprintf(buf, "%s", tbuf2);
-    break;
-  case CASS_VALUE_TYPE_INET:
-    TRYCASS(cass_value_get_inet(value, &val_inet));
-    cass_inet_string(val_inet, tbuf2);
-    sprintf(buf, "%s", tbuf2);
-    break;
-  case CASS_VALUE_TYPE_BLOB:
-  case CASS_VALUE_TYPE_VARINT:
-  case CASS_VALUE_TYPE_LIST:
-  case CASS_VALUE_TYPE_MAP:
-  case CASS_VALUE_TYPE_SET:
-    TRYCASS(cass_value_get_bytes(value, &val_byte, &tbufsize));
-    if (tbufsize < bufsize - 1) {
-      memcpy(buf, val_byte, tbufsize);
-      buf[tbufsize] = '\0';
-    }
-    break;
-  default:
-    break;
+/************************************************************************
+/* run_scan: read every range, window at a time; returns false if any
+/*           range failed
+/*
+/* The calling thread is the scan's writer: it writes queued output to
+/* stdout and restarts parked ranges until every range is done.
+/************************************************************************/
+
+bool run_scan(Scan *scan, int window) {
+  ScanRange *ranges;
+  uint64_t step;
+  int r;
+
+  scan->bounds = malloc((scan->numRanges + 1) * sizeof(cass_int64_t));
+  ranges = calloc(window, sizeof(ScanRange));
+  if ((NULL == scan->bounds) || (NULL == ranges)) {
+    fprintf(stderr, "Unable to allocate %d scan ranges\n", scan->numRanges);
+    exit(-1);
   }
-  return buf;
+  // Murmur3 tokens cover (INT64_MIN, INT64_MAX]; INT64_MIN itself is
+  // never produced by the partitioner.
+  step = UINT64_MAX / scan->numRanges;
+  for (r = 0; r < scan->numRanges; r++)
+    scan->bounds[r] = (cass_int64_t)((uint64_t)INT64_MIN + r * step);
+  scan->bounds[scan->numRanges] = INT64_MAX;
+
+  pthread_mutex_lock(&scan->lock);
+  scan->queue = NULL;
+  scan->queueTail = &scan->queue;
+  if (window > scan->numRanges)
+    window = scan->numRanges;
+  scan->active = window;
+  scan->nextRange = window;
+  pthread_mutex_unlock(&scan->lock);
+  for (r = 0; r < window; r++) {
+    ranges[r].scan = scan;
+    scan_start(&ranges[r], r);
+  }
+
+  pthread_mutex_lock(&scan->lock);
+  for (;;) {
+    while (NULL != scan->queue) {
+      OutBuf *b = scan->queue;
+      CsvOut out;
+
+      scan->queue = b->next;
+      if (NULL == scan->queue)
+	scan->queueTail = &scan->queue;
+      pthread_mutex_unlock(&scan->lock);
+
+      out.fd = STDOUT_FILENO;
+      out.buf = b->buf;
+      out.len = b->len;
+      out.cap = b->len;
+      out.failed = false;
+      csv_out_flush(&out);
+
+      pthread_mutex_lock(&scan->lock);
+      scan->queued -= b->len;
+      b->next = scan->spare;
+      scan->spare = b;
+    }
+    if ((scan->parked > 0) && (scan->queued <= SCAN_MAX_QUEUED)) {
+      for (r = 0; r < window; r++) {
+	if (!ranges[r].parked)
+	  continue;
+	ranges[r].parked = false;
+	scan->parked--;
+	pthread_mutex_unlock(&scan->lock);
+	scan_execute(&ranges[r]);
+	pthread_mutex_lock(&scan->lock);
+      }
+      // Output may have been queued while the lock was dropped
+      continue;
+    }
+    if (0 == scan->active)
+      break;
+    pthread_cond_wait(&scan->cond, &scan->lock);
+  }
+  while (NULL != scan->spare) {
+    OutBuf *b = scan->spare;
+
+    scan->spare = b->next;
+    free(b->buf);
+    free(b);
+  }
+  pthread_mutex_unlock(&scan->lock);
+
+  free(ranges);
+  free(scan->bounds);
+  return !scan->failed;
+}
+
+static struct option long_options[] = {
+  {"pagesize", required_argument, NULL, 'g'},
+  {"scan",     required_argument, NULL, 's'},
+  {"window",   required_argument, NULL, 'w'},
+  {"partkey",  required_argument, NULL, 'k'},
+  {"groupmax", no_argument,       NULL, 'm'},
+  {NULL,       0,                 NULL, 0}
+};
+
+void usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [options] <contact_points> <Query> [silent]\n", prog);
+  fprintf(stderr, "  --pagesize <n>     rows per page (default %d)\n", DEFAULT_PAGE_SIZE);
+  fprintf(stderr, "  --scan <n>         split the token ring into n ranges and read them in parallel\n");
+  fprintf(stderr, "  --window <n>       ranges read at once when scanning (default %d)\n", DEFAULT_SCAN_WINDOW);
+  fprintf(stderr, "  --partkey <col>    partition key column for --scan (default %s)\n", DEFAULT_PARTITION_KEY);
+  fprintf(stderr, "  --groupmax         output MAX(second column) grouped by the first column,\n");
+  fprintf(stderr, "                     or MAX of a single column, computed client side\n");
 }
 
 int main(int argc, char **argv) {
   char *contact_points;
   char *query;
   bool silent = false;
-  
-  if ((argc != 3) && (argc != 4)) {
-    fprintf(stderr, "Usage: %s <contact_points> <Query> [silent]\n", argv[0]);
+  int pageSize = DEFAULT_PAGE_SIZE;
+  int numRanges = 0;
+  int window = DEFAULT_SCAN_WINDOW;
+  char *partKey = DEFAULT_PARTITION_KEY;
+  bool groupMax = false;
+  GroupMax groups;
+  bool groupKeys = true;
+  int opt;
+
+  while (-1 != (opt = getopt_long(argc, argv, "g:s:w:k:m", long_options, NULL))) {
+    switch (opt) {
+    case 'g':
+      pageSize = atoi(optarg);
+      if (pageSize < 1) {
+	usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 's':
+      numRanges = atoi(optarg);
+      if (numRanges < 1) {
+	usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'w':
+      window = atoi(optarg);
+      if (window < 1) {
+	usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'k':
+      partKey = optarg;
+      break;
+    case 'm':
+      groupMax = true;
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if ((argc - optind != 2) && (argc - optind != 3)) {
+    usage(argv[0]);
     return 1;
   }
-  contact_points = argv[1];
-  query = argv[2];
-  if (4 == argc) {
-    if (0 != strncmp("silent", argv[3], 6)) {
-      fprintf(stderr, "Usage: %s <ConnString> <Query> [silent]\n", argv[0]);
+  contact_points = argv[optind];
+  query = argv[optind + 1];
+  if (argc - optind == 3) {
+    if (0 != strncmp("silent", argv[optind + 2], 6)) {
+      usage(argv[0]);
       return 1;
     }
     else {
@@ -168,46 +586,133 @@ int main(int argc, char **argv) {
   CassStatement* statement = NULL;
   CassFuture* future = NULL;
   long numResults = 0;
-  const char *tbuf;
-  size_t blen;
-  char buf[1025];
+  CsvOut out;
 
-  statement = cass_statement_new(query, 0);
-  future = cass_session_execute(session, statement);
-  cass_future_wait(future);
+  if (groupMax && (0 != group_max_init(&groups, GROUP_MAX_DEFAULT_SIZE))) {
+    fprintf(stderr, "Unable to allocate group table\n");
+    return -1;
+  }
 
-  rc = cass_future_error_code(future);
-  if (rc != CASS_OK) {
-    print_error(future);
-  } 
-  else {
-    const CassResult* result = cass_future_get_result(future);
-    size_t nCols = cass_result_column_count(result);
-    size_t i;
-    CassIterator* iterator = cass_iterator_from_result(result);
-
-    while (cass_true == cass_iterator_next(iterator)) {
-      if (!silent) {
-	const CassRow* row = cass_iterator_get_row(iterator);
-	const CassValue* val = cass_row_get_column(row, 0);
-	printf("%s", get_column_as_string(val, buf, sizeof(buf)));
-	for (i = 1; i < nCols; i++) {
-	  val = cass_row_get_column(row, i);
-	  printf(",%s", get_column_as_string(val, buf, sizeof(buf)));
+  long pages = 0;
+  bool ok = true;
+  long long t0 = now_nanos();
+  if (numRanges > 0) {
+    Scan scan;
+    int t;
+    char *rangeQuery = add_token_range(query, partKey);
+
+    memset(&scan, 0, sizeof(scan));
+    if (NULL == rangeQuery) {
+      fprintf(stderr, "Unable to allocate query\n");
+      return -1;
+    }
+    future = cass_session_prepare(session, rangeQuery);
+    cass_future_wait(future);
+    rc = cass_future_error_code(future);
+    if (rc != CASS_OK) {
+      fprintf(stderr, "Preparing: %s\n", rangeQuery);
+      print_error(future);
+      ok = false;
+    }
+    else {
+      scan.prepared = cass_future_get_prepared(future);
+    }
+    cass_future_free(future);
+
+    if (NULL != scan.prepared) {
+      scan.session = session;
+      scan.pageSize = pageSize;
+      scan.silent = silent;
+      scan.groupMax = groupMax;
+      scan.numRanges = numRanges;
+      pthread_mutex_init(&scan.lock, NULL);
+      pthread_cond_init(&scan.cond, NULL);
+      if (!run_scan(&scan, window)) {
+	fprintf(stderr, "Some token ranges failed; results are incomplete\n");
+	ok = false;
+      }
+      numResults = scan.rows;
+      pages = scan.pages;
+      groupKeys = (scan.numCols > 1);
+      for (t = 0; t < scan.numTables; t++) {
+	if (0 != group_max_merge(&groups, scan.tables[t])) {
+	  fprintf(stderr, "Unable to grow group table\n");
+	  return -1;
 	}
-	printf("\n");
+	group_max_free(scan.tables[t]);
+	free(scan.tables[t]);
       }
-      numResults++;
+      free(scan.tables);
+      pthread_cond_destroy(&scan.cond);
+      pthread_mutex_destroy(&scan.lock);
+      cass_prepared_free(scan.prepared);
     }
+    free(rangeQuery);
+  }
+  else {
+    if (!silent && !groupMax && (0 != csv_out_init(&out, STDOUT_FILENO, CSV_OUT_DEFAULT_SIZE)))
+      return -1;
 
-    cass_result_free(result);
-    cass_iterator_free(iterator);
+    statement = cass_statement_new(query, 0);
+    TRYCASS(cass_statement_set_paging_size(statement, pageSize));
+    future = cass_session_execute(session, statement);
+
+    // Request page n+1 as soon as page n arrives, so the transfer of the
+    // next page overlaps decoding and writing this one.
+    while (NULL != future) {
+      const CassResult* result;
+
+      cass_future_wait(future);
+      rc = cass_future_error_code(future);
+      if (rc != CASS_OK) {
+	print_error(future);
+	cass_future_free(future);
+	ok = false;
+	break;
+      }
+      result = cass_future_get_result(future);
+      cass_future_free(future);
+      future = NULL;
+
+      if (cass_result_has_more_pages(result)) {
+	TRYCASS(cass_statement_set_paging_state(statement, result));
+	future = cass_session_execute(session, statement);
+      }
+
+      if (groupMax) {
+	groupKeys = (cass_result_column_count(result) > 1);
+	numResults += aggregate_page(result, &groups);
+      }
+      else
+	numResults += consume_page(result, silent, &out, NULL);
+      pages++;
+      cass_result_free(result);
+    }
+    if (!silent && !groupMax)
+      csv_out_free(&out);
+    cass_statement_free(statement);
+  }
+  if (groupMax) {
+    if (!silent) {
+      if (0 != csv_out_init(&out, STDOUT_FILENO, CSV_OUT_DEFAULT_SIZE))
+	return -1;
+      group_max_write(&out, &groups, groupKeys);
+      csv_out_free(&out);
+    }
   }
+  double elapsed = (double)(now_nanos() - t0) / NANOS_PER_SEC;
 
   fprintf(stderr, "numResults = %ld\n", numResults);
-
-  cass_future_free(future);
-  cass_statement_free(statement);
+  fprintf(stderr, "pages = %ld (page size %d)\n", pages, pageSize);
+  if (groupMax) {
+    fprintf(stderr, "groups = %llu\n", (unsigned long long)groups.count);
+    group_max_free(&groups);
+  }
+  if (numRanges > 0)
+    fprintf(stderr, "token ranges = %d (%d at a time)\n", numRanges,
+	    (window < numRanges) ? window : numRanges);
+  fprintf(stderr, "%.3f s, %.1f rows/s\n",
+	  elapsed, (elapsed > 0) ? numResults / elapsed : 0.0);
 
   close_future = cass_session_close(session);
   cass_future_wait(close_future);
@@ -216,5 +721,6 @@ int main(int argc, char **argv) {
   cass_cluster_free(cluster);
   cass_session_free(session);
 
-  return 0;
+  // A failed or partial read is not a result
+  return ok ? 0 : 1;
 }
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "csvin.h"
+
+/************************************************************************
+/* csv_in_init: set up a reader on fd with a cap byte buffer
+/*
+/* Returns 0 on success, -1 if the buffer could not be allocated.
+/************************************************************************/
+
+int csv_in_init(CsvIn *in, int fd, size_t cap) {
+  in->fd = fd;
+  in->len = 0;
+  in->pos = 0;
+  in->line = 0;
+  in->cap = (cap < 64) ? 64 : cap;
+  in->buf = malloc(in->cap);
+  if (NULL == in->buf) {
+    fprintf(stderr, "Unable to allocate %zu byte input buffer\n", in->cap);
+    return -1;
+  }
+  return 0;
+}
+
+void csv_in_free(CsvIn *in) {
+  free(in->buf);
+  in->buf = NULL;
+}
+
+/************************************************************************
+/* csv_in_fill: refill the buffer; returns 1 if anything was read, 0 at
+/*              end of file, or -1 on error
+/************************************************************************/
+
+int csv_in_fill(CsvIn *in) {
+  ssize_t n;
+
+  do {
+    n = read(in->fd, in->buf, in->cap);
+  } while ((n < 0) && (EINTR == errno));
+  if (n < 0) {
+    perror("read");
+    return -1;
+  }
+  in->len = n;
+  in->pos = 0;
+  return (int)(n > 0);
+}
+
+/************************************************************************
+/* csv_in_row: parse one line of n integers into vals
+/*
+/* Returns 1 for a row, 0 at end of file, or -1 on a malformed line.
+/* Blank lines are skipped.
+/************************************************************************/
+
+int csv_in_row(CsvIn *in, int64_t *vals, int n) {
+  int c, f;
+
+  do {
+    c = csv_in_byte(in);
+    in->line++;
+  } while (('\n' == c) || ('\r' == c));
+  if (c < 0)
+    return 0;
+
+  for (f = 0; f < n; f++) {
+    bool     negative = false;
+    bool     digits = false;
+    uint64_t v = 0;
+
+    if ('-' == c) {
+      negative = true;
+      c = csv_in_byte(in);
+    }
+    while ((c >= '0') && (c <= '9')) {
+      v = v * 10 + (c - '0');
+      digits = true;
+      c = csv_in_byte(in);
+    }
+    if (!digits)
+      return -1;
+    vals[f] = negative ? -(int64_t)v : (int64_t)v;
+    if (f < n - 1) {
+      if (',' != c)
+	return -1;
+      c = csv_in_byte(in);
+    }
+  }
+  if ('\r' == c)
+    c = csv_in_byte(in);
+  return (('\n' == c) || (c < 0)) ? 1 : -1;
+}
@@ -0,0 +1,46 @@
+#ifndef CSVIN_H
+#define CSVIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*****************************************/
+/* Buffered reader for integer CSV       */
+/*                                       */
+/* Reads gen output: lines of comma-     */
+/* separated integers, filled a large    */
+/* buffer at a time with read(2).        */
+/*****************************************/
+
+#define CSV_IN_DEFAULT_SIZE (1 << 20)
+
+typedef struct {
+  int        fd;
+  char      *buf;
+  size_t     len;
+  size_t     pos;
+  size_t     cap;
+  long long  line;             // Line of the last row read
+} CsvIn;
+
+int  csv_in_init(CsvIn *in, int fd, size_t cap);
+void csv_in_free(CsvIn *in);
+int  csv_in_fill(CsvIn *in);
+int  csv_in_row(CsvIn *in, int64_t *vals, int n);
+
+// Start reading a new file with the same buffer
+static inline void csv_in_reset(CsvIn *in, int fd) {
+  in->fd = fd;
+  in->len = 0;
+  in->pos = 0;
+  in->line = 0;
+}
+
+// Next byte of input, or -1 at end of file or on error
+static inline int csv_in_byte(CsvIn *in) {
+  if ((in->pos == in->len) && (csv_in_fill(in) <= 0))
+    return -1;
+  return (unsigned char)in->buf[in->pos++];
+}
+
+#endif
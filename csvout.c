@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "csvout.h"
+
+static const char digitPairs[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+/************************************************************************
+/* csv_out_init: set up a writer on fd with a cap byte buffer
+/*
+/* Returns 0 on success, -1 if the buffer could not be allocated.
+/************************************************************************/
+
+int csv_out_init(CsvOut *out, int fd, size_t cap) {
+  out->fd = fd;
+  out->len = 0;
+  out->cap = (cap < 64) ? 64 : cap;
+  out->failed = false;
+  out->buf = malloc(out->cap);
+  if (NULL == out->buf) {
+    fprintf(stderr, "Unable to allocate %zu byte output buffer\n", out->cap);
+    return -1;
+  }
+  return 0;
+}
+
+/************************************************************************
+/* csv_out_free: flush anything pending and release the buffer
+/************************************************************************/
+
+void csv_out_free(CsvOut *out) {
+  if (NULL != out->buf)
+    csv_out_flush(out);
+  free(out->buf);
+  out->buf = NULL;
+  out->len = out->cap = 0;
+}
+
+/************************************************************************
+/* csv_out_flush: hand the buffered bytes to write(2)
+/*
+/* Returns 0 on success, -1 after the first write error (which is
+/* reported once; later output is discarded).
+/************************************************************************/
+
+int csv_out_flush(CsvOut *out) {
+  size_t off = 0;
+
+  while ((off < out->len) && !out->failed) {
+    ssize_t n = write(out->fd, out->buf + off, out->len - off);
+    if (n < 0) {
+      if (EINTR == errno)
+	continue;
+      perror("write");
+      out->failed = true;
+      break;
+    }
+    off += n;
+  }
+  out->len = 0;
+  return out->failed ? -1 : 0;
+}
+
+/************************************************************************
+/* csv_out_room: make room for n more bytes by writing out the buffer,
+/*               or with fd -1 by growing it
+/************************************************************************/
+
+void csv_out_room(CsvOut *out, size_t n) {
+  size_t cap = out->cap;
+  char *buf;
+
+  if (out->fd >= 0) {
+    csv_out_flush(out);
+    return;
+  }
+  while (out->len + n > cap)
+    cap *= 2;
+  if (cap == out->cap)
+    return;
+  buf = realloc(out->buf, cap);
+  if (NULL == buf) {
+    fprintf(stderr, "Unable to grow output buffer to %zu bytes\n", cap);
+    exit(-1);
+  }
+  out->buf = buf;
+  out->cap = cap;
+}
+
+/************************************************************************
+/* csv_out_raw: append bytes as-is
+/************************************************************************/
+
+void csv_out_raw(CsvOut *out, const char *s, size_t len) {
+  if (len > out->cap - out->len) {
+    csv_out_room(out, len);
+    if (len > out->cap - out->len) {
+      // Too big to buffer, send it straight through
+      CsvOut direct = *out;
+      direct.buf = (char *)s;
+      direct.len = len;
+      csv_out_flush(&direct);
+      out->failed = direct.failed;
+      return;
+    }
+  }
+  memcpy(out->buf + out->len, s, len);
+  out->len += len;
+}
+
+/************************************************************************
+/* csv_out_text: append a text field, quoting it per RFC 4180 when it
+/*               contains a separator, quote or line break
+/************************************************************************/
+
+void csv_out_text(CsvOut *out, const char *s, size_t len) {
+  size_t i;
+  size_t start;
+
+  for (i = 0; i < len; i++) {
+    char c = s[i];
+    if ((',' == c) || ('"' == c) || ('\n' == c) || ('\r' == c))
+      break;
+  }
+  if (i == len) {
+    csv_out_raw(out, s, len);
+    return;
+  }
+
+  csv_out_char(out, '"');
+  for (start = 0, i = 0; i < len; i++) {
+    if ('"' == s[i]) {
+      // Emit through the quote, then double it
+      csv_out_raw(out, s + start, i + 1 - start);
+      start = i;
+    }
+  }
+  csv_out_raw(out, s + start, len - start);
+  csv_out_char(out, '"');
+}
+
+/************************************************************************
+/* csv_out_double: append a double with 15 significant digits
+/************************************************************************/
+
+void csv_out_double(CsvOut *out, double v) {
+  char *p = csv_out_reserve(out, 32);
+  out->len += snprintf(p, 32, "%.15g", v);
+}
+
+/************************************************************************
+/* csv_format_int64: write the decimal form of v at dst, two digits at
+/*                   a time
+/*
+/* dst must have room for 20 bytes.  Returns the end of the digits (no
+/* terminator is written).
+/************************************************************************/
+
+char *csv_format_int64(char *dst, long long v) {
+  unsigned long long u = (unsigned long long)v;
+  unsigned long long t;
+  int ndigits;
+  char *end;
+
+  if (v < 0) {
+    *dst++ = '-';
+    u = 0 - u;
+  }
+
+  for (ndigits = 1, t = u; t >= 10; t /= 10)
+    ndigits++;
+  end = dst + ndigits;
+
+  while (u >= 100) {
+    unsigned idx = (unsigned)(u % 100) * 2;
+    u /= 100;
+    dst[--ndigits] = digitPairs[idx + 1];
+    dst[--ndigits] = digitPairs[idx];
+  }
+  if (u >= 10) {
+    dst[1] = digitPairs[u * 2 + 1];
+    dst[0] = digitPairs[u * 2];
+  }
+  else {
+    dst[0] = '0' + (char)u;
+  }
+  return end;
+}
+
+/************************************************************************
+/* csv_format_uint32: as csv_format_int64 for small unsigned values,
+/*                    counting digits by comparison
+/*
+/* dst must have room for 10 bytes.
+/************************************************************************/
+
+char *csv_format_uint32(char *dst, unsigned v) {
+  int ndigits = (v < 10) ? 1 : (v < 100) ? 2 : (v < 1000) ? 3 :
+    (v < 10000) ? 4 : (v < 100000) ? 5 : (v < 1000000) ? 6 :
+    (v < 10000000) ? 7 : (v < 100000000) ? 8 : (v < 1000000000) ? 9 : 10;
+  char *end = dst + ndigits;
+
+  while (v >= 100) {
+    unsigned idx = (v % 100) * 2;
+    v /= 100;
+    dst[--ndigits] = digitPairs[idx + 1];
+    dst[--ndigits] = digitPairs[idx];
+  }
+  if (v >= 10) {
+    dst[1] = digitPairs[v * 2 + 1];
+    dst[0] = digitPairs[v * 2];
+  }
+  else {
+    dst[0] = '0' + (char)v;
+  }
+  return end;
+}
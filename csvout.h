@@ -0,0 +1,57 @@
+#ifndef CSVOUT_H
+#define CSVOUT_H
+
+#include <stddef.h>
+#include <string.h>
+#include <stdbool.h>
+
+/*****************************************/
+/* Buffered CSV writer                   */
+/*                                       */
+/* Rows are formatted straight into one  */
+/* large reusable buffer which is handed */
+/* to write(2) a chunk at a time.  With  */
+/* fd -1 nothing is written: the buffer  */
+/* grows to hold whatever is appended,   */
+/* and its owner takes the bytes.        */
+/*****************************************/
+
+#define CSV_OUT_DEFAULT_SIZE (1 << 20)
+
+typedef struct {
+  int    fd;
+  char  *buf;
+  size_t len;
+  size_t cap;
+  bool   failed;
+} CsvOut;
+
+int  csv_out_init(CsvOut *out, int fd, size_t cap);
+void csv_out_free(CsvOut *out);
+int  csv_out_flush(CsvOut *out);
+void csv_out_room(CsvOut *out, size_t n);
+
+void csv_out_raw(CsvOut *out, const char *s, size_t len);
+void csv_out_text(CsvOut *out, const char *s, size_t len);
+void csv_out_double(CsvOut *out, double v);
+char *csv_format_int64(char *dst, long long v);
+char *csv_format_uint32(char *dst, unsigned v);
+
+// Make room for at least n more bytes
+static inline char *csv_out_reserve(CsvOut *out, size_t n) {
+  if (out->len + n > out->cap)
+    csv_out_room(out, n);
+  return out->buf + out->len;
+}
+
+static inline void csv_out_char(CsvOut *out, char c) {
+  *csv_out_reserve(out, 1) = c;
+  out->len++;
+}
+
+static inline void csv_out_int64(CsvOut *out, long long v) {
+  char *p = csv_out_reserve(out, 20);
+  out->len += csv_format_int64(p, v) - p;
+}
+
+#endif
@@ -2,153 +2,356 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "cassandra.h"
+#include "csvout.h"
+#include "cassutil.h"
+#include "timing.h"
+#include "hist.h"
+#include "keydist.h"
 
-#define TRYCASS(x)   {   CassError rc = x;			\
-  if (rc != CASS_OK)						\
-    {								\
-      fprintf(stderr, "ERROR: %s\n", cass_error_desc(rc));	\
-      exit(-1);							\
-    }								\
+#define DEFAULT_ITERATIONS (100000)
+
+// Bound statements carry the routing key, so a token-aware policy can
+// send them straight to a replica; plain statements need none.
+CassStatement* new_statement(const char* query, const CassPrepared* prepared) {
+  if (NULL != prepared)
+    return cass_prepared_bind(prepared);
+  return cass_statement_new(query, 1);
+}
+
+/************************************************************************
+/* consume_result: count the rows of a result, writing them as CSV
+/*                 unless silent
+/************************************************************************/
+
+long consume_result(const CassResult *result, bool silent, CsvOut *out) {
+  RowFormat format;
+  long numResults = 0;
+  CassIterator* iterator = cass_iterator_from_result(result);
+
+  if (!silent)
+    row_format_init(&format, result);
+  while (cass_true == cass_iterator_next(iterator)) {
+    if (!silent)
+      write_row(out, cass_iterator_get_row(iterator), &format);
+    numResults++;
   }
+  cass_iterator_free(iterator);
 
-void print_error(CassFuture* future) {
-  const char* message;
-  size_t message_length;
-  cass_future_error_message(future, &message, &message_length);
-  fprintf(stderr, "Error: %.*s\n", (int)message_length, message);
+  if (!silent) {
+    // Keep the rows ahead of the stdio iteration line
+    fflush(stdout);
+    csv_out_flush(out);
+  }
+  return numResults;
 }
 
-CassCluster* create_cluster(const char* contact_points) {
-  CassCluster* cluster = cass_cluster_new();
-  cass_cluster_set_contact_points(cluster, contact_points);
-  return cluster;
+/*****************************************/
+/* Pipelined window of requests          */
+/*                                       */
+/* Up to window requests are in flight.  */
+/* Completion callbacks run on driver    */
+/* I/O threads and share this state      */
+/* under lock.  Results are consumed     */
+/* into a per-I/O-thread buffer, and     */
+/* latencies recorded into per-I/O-      */
+/* thread histograms, outside it.  A     */
+/* callback only returns its slot to the */
+/* idle list; run_pipeline sends every   */
+/* request, so a callback the driver     */
+/* runs inline cannot recurse.           */
+/*****************************************/
+typedef struct PipelineRequest_ PipelineRequest;
+typedef struct ThreadHists_ ThreadHists;
+
+typedef struct {
+  CassSession *session;
+  const char *query;
+  const CassPrepared *prepared; // NULL to send the raw query text
+  long long iterations;
+  bool silent;
+  double interval;             // Open loop spacing, 0 for closed loop
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  struct drand48_data lcg;
+  KeyDist keydist;
+  long long issued;
+  atomic_llong numbered;       // Iteration lines printed
+  long long completed;
+  PipelineRequest **idle;      // Slots free to send
+  int numIdle;
+  ThreadHists *hists;          // Every callback thread's histograms
+} Pipeline;
+
+struct PipelineRequest_ {
+  Pipeline *pipeline;
+  long long intended;
+  long long sent;
+};
+
+struct ThreadHists_ {
+  Histogram latency;
+  Histogram service;
+  ThreadHists *next;
+};
+
+static __thread CsvOut resultOut;
+static __thread ThreadHists *resultHists;
+
+void on_result(CassFuture *future, void *data);
+
+// drand48_r as a KeyDistRandom
+double next_uniform(void *state) {
+  double rval;
+  drand48_r((struct drand48_data *)state, &rval);
+  return rval;
 }
 
-CassError connect_session(CassSession* session, const CassCluster* cluster) {
-  CassError rc = CASS_OK;
-  CassFuture* future = cass_session_connect(session, cluster);
+// Draw the next key; caller holds the lock
+cass_int64_t next_key(Pipeline *p) {
+  p->issued++;
+  return (cass_int64_t)keydist_next(&p->keydist, next_uniform, &p->lcg);
+}
 
-  cass_future_wait(future);
-  rc = cass_future_error_code(future);
-  if (rc != CASS_OK) {
-    print_error(future);
-  }
+void send_request(PipelineRequest *req, cass_int64_t key) {
+  Pipeline *p = req->pipeline;
+  CassStatement *statement = new_statement(p->query, p->prepared);
+  CassFuture *future;
+
+  cass_statement_bind_int64(statement, 0, key);
+  req->sent = now_nanos();
+  if (p->interval <= 0)
+    req->intended = req->sent;
+  future = cass_session_execute(p->session, statement);
+  cass_statement_free(statement);
+  // The driver keeps the future alive until the callback has run
+  TRYCASS(cass_future_set_callback(future, on_result, req));
   cass_future_free(future);
+}
 
-  return rc;
+// This callback thread's histograms, registered with p on first use
+static ThreadHists *thread_hists(Pipeline *p) {
+  if (NULL == resultHists) {
+    resultHists = malloc(sizeof(ThreadHists));
+    if (NULL == resultHists) {
+      fprintf(stderr, "Unable to allocate histograms\n");
+      exit(-1);
+    }
+    hist_init(&resultHists->latency);
+    hist_init(&resultHists->service);
+    pthread_mutex_lock(&p->lock);
+    resultHists->next = p->hists;
+    p->hists = resultHists;
+    pthread_mutex_unlock(&p->lock);
+  }
+  return resultHists;
 }
 
-CassError execute_query(CassSession* session, const char* query) {
-  CassError rc = CASS_OK;
-  CassFuture* future = NULL;
-  CassStatement* statement = cass_statement_new(query, 0);
+/************************************************************************
+/* on_result: completion callback for a pipelined request
+/*
+/* Records the latency and puts the slot back on the idle list for
+/* run_pipeline to send the next request from.  The result is written
+/* out before the request counts as completed, so nothing is still
+/* printing when run_pipeline returns.
+/************************************************************************/
 
-  future = cass_session_execute(session, statement);
-  cass_future_wait(future);
+void on_result(CassFuture *future, void *data) {
+  PipelineRequest *req = (PipelineRequest *)data;
+  Pipeline *p = req->pipeline;
+  long long done = now_nanos();
+  const CassResult *result = NULL;
+  long numResults = 0;
+  ThreadHists *hists = thread_hists(p);
 
-  rc = cass_future_error_code(future);
-  if (rc != CASS_OK) {
+  if (CASS_OK != cass_future_error_code(future))
     print_error(future);
-  }  
+  else
+    result = cass_future_get_result(future);
 
-  cass_future_free(future);
-  cass_statement_free(statement);
-  
-  return rc;
+  if (NULL != result) {
+    if (!p->silent && (NULL == resultOut.buf)) {
+      if (0 != csv_out_init(&resultOut, STDOUT_FILENO, CSV_OUT_DEFAULT_SIZE))
+	exit(-1);
+    }
+    numResults = consume_result(result, p->silent, &resultOut);
+    cass_result_free(result);
+  }
+  fprintf(stdout, "iteration %lld: numResults = %ld\n",
+	  atomic_fetch_add_explicit(&p->numbered, 1, memory_order_relaxed),
+	  numResults);
+
+  hist_record(&hists->latency, done - req->intended);
+  hist_record(&hists->service, done - req->sent);
+
+  pthread_mutex_lock(&p->lock);
+  p->completed++;
+  p->idle[p->numIdle++] = req;
+  pthread_cond_signal(&p->cond);
+  pthread_mutex_unlock(&p->lock);
 }
 
-char* get_column_as_string(const CassValue *value, char* buf, int bufsize) {
-  buf[0] = '\0';
-  const char *tbuf;
-  char *tbuf2;
-  size_t tbufsize;
-  CassValueType vtype = cass_value_type(value);
-  cass_int64_t val_int64;
-  cass_int32_t val_int32;
-  cass_float_t val_float;
-  cass_double_t val_double;
-  cass_bool_t val_bool;
-  CassUuid val_uuid;
-  CassInet val_inet;
-  const cass_byte_t *val_byte;
-  
-  switch (vtype) {
-  case CASS_VALUE_TYPE_ASCII:
-  case CASS_VALUE_TYPE_TEXT:
-  case CASS_VALUE_TYPE_VARCHAR:
-    TRYCASS(cass_value_get_string(value, &tbuf, &tbufsize));
-    if (tbufsize < bufsize - 1) {
-      memcpy(buf, tbuf, tbufsize);
-      buf[tbufsize] = '\0';
+/************************************************************************
+/* run_pipeline: run all iterations with up to window requests in flight
+/*
+/* Merges the callback threads' histograms into latency and service.
+/************************************************************************/
+
+void run_pipeline(Pipeline *p, int window, Histogram *latency, Histogram *service) {
+  PipelineRequest *reqs = calloc(window, sizeof(PipelineRequest));
+  long long t0 = now_nanos();
+  ThreadHists *hists;
+  long long i;
+  int w;
+
+  p->idle = calloc(window, sizeof(PipelineRequest *));
+  if ((NULL == reqs) || (NULL == p->idle)) {
+    fprintf(stderr, "Unable to allocate a window of %d requests\n", window);
+    exit(-1);
+  }
+  for (w = 0; w < window; w++) {
+    reqs[w].pipeline = p;
+    p->idle[p->numIdle++] = &reqs[w];
+  }
+
+  pthread_mutex_lock(&p->lock);
+  if (p->interval > 0) {
+    // Open loop: send each request when it is due and a slot is free
+    for (i = 0; i < p->iterations; i++) {
+      long long intended = t0 + (long long)(i * p->interval);
+      PipelineRequest *req;
+      cass_int64_t key;
+
+      pthread_mutex_unlock(&p->lock);
+      sleep_until_nanos(intended);
+      pthread_mutex_lock(&p->lock);
+      while (0 == p->numIdle)
+	pthread_cond_wait(&p->cond, &p->lock);
+      req = p->idle[--p->numIdle];
+      req->intended = intended;
+      key = next_key(p);
+      pthread_mutex_unlock(&p->lock);
+      send_request(req, key);
+      pthread_mutex_lock(&p->lock);
     }
-    break;
-  case CASS_VALUE_TYPE_BIGINT:
-  case CASS_VALUE_TYPE_TIMESTAMP:
-    TRYCASS(cass_value_get_int64(value, &val_int64));
-    sprintf(buf, "%lld", (long long)val_int64);
-    break;
-  case CASS_VALUE_TYPE_INT:
-    TRYCASS(cass_value_get_int32(value, &val_int32));
-    sprintf(buf, "%d", (int)val_int32);
-    break;
-  case CASS_VALUE_TYPE_FLOAT:
-    TRYCASS(cass_value_get_float(value, &val_float));
-    sprintf(buf, "%f", (float)val_float);
-    break;
-  case CASS_VALUE_TYPE_DOUBLE:
-    TRYCASS(cass_value_get_double(value, &val_double));
-    sprintf(buf, "%f", (double)val_double);
-    break;
-  case CASS_VALUE_TYPE_BOOLEAN:
-    TRYCASS(cass_value_get_bool(value, &val_bool));
-    sprintf(buf, "%s", (val_bool == cass_true) ? "1" : "0");
-    break;
-  case CASS_VALUE_TYPE_UUID:
-  case CASS_VALUE_TYPE_TIMEUUID:
-    TRYCASS(cass_value_get_uuid(value, &val_uuid));
-    cass_uuid_string(val_uuid, tbuf2);
-    sprintf(buf, "%s", tbuf2);
-    break;
-  case CASS_VALUE_TYPE_INET:
-    TRYCASS(cass_value_get_inet(value, &val_inet));
-    cass_inet_string(val_inet, tbuf2);
-    sprintf(buf, "%s", tbuf2);
-    break;
-  case CASS_VALUE_TYPE_BLOB:
-  case CASS_VALUE_TYPE_VARINT:
-  case CASS_VALUE_TYPE_LIST:
-  case CASS_VALUE_TYPE_MAP:
-  case CASS_VALUE_TYPE_SET:
-    TRYCASS(cass_value_get_bytes(value, &val_byte, &tbufsize));
-    if (tbufsize < bufsize - 1) {
-      memcpy(buf, val_byte, tbufsize);
-      buf[tbufsize] = '\0';
+  }
+  else {
+    // Closed loop: send from each slot as soon as it is free
+    while (p->issued < p->iterations) {
+      PipelineRequest *req;
+      cass_int64_t key;
+
+      while (0 == p->numIdle)
+	pthread_cond_wait(&p->cond, &p->lock);
+      req = p->idle[--p->numIdle];
+      key = next_key(p);
+      pthread_mutex_unlock(&p->lock);
+      send_request(req, key);
+      pthread_mutex_lock(&p->lock);
     }
-    break;
-  default:
-    break;
   }
-  return buf;
+  while (p->completed < p->iterations)
+    pthread_cond_wait(&p->cond, &p->lock);
+  pthread_mutex_unlock(&p->lock);
+
+  // The callbacks are done with their histograms, though their threads
+  // may still be running
+  while (NULL != (hists = p->hists)) {
+    p->hists = hists->next;
+    hist_merge(latency, &hists->latency);
+    hist_merge(service, &hists->service);
+    free(hists);
+  }
+  free(p->idle);
+  free(reqs);
+}
+
+static struct option long_options[] = {
+  {"iterations", required_argument, NULL, 'n'},
+  {"rate",       required_argument, NULL, 'r'},
+  {"window",     required_argument, NULL, 'w'},
+  {"prepare",    no_argument,       NULL, 'p'},
+  {"keydist",    required_argument, NULL, 'k'},
+  {NULL,         0,                 NULL, 0}
+};
+
+void usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [options] <contact_points> <pkey range> <ccol range> <rand seed>\n", prog);
+  fprintf(stderr, "  --iterations <n>   queries to run (default %d)\n", DEFAULT_ITERATIONS);
+  fprintf(stderr, "  --rate <qps>       open loop: issue queries on a fixed schedule\n");
+  fprintf(stderr, "  --window <n>       keep n asynchronous requests in flight\n");
+  fprintf(stderr, "  --prepare          prepare the query on the cluster and bind from it\n");
+  fprintf(stderr, "  --keydist <dist>   key distribution: %s\n", KEYDIST_SPEC_HELP);
 }
 
 int main(int argc, char **argv) {
   char *contact_points;
   char query[] = "SELECT col1 FROM otest.test10 WHERE pkey = ?";
   bool silent = true;
-  
-  if (argc != 5) {
-    fprintf(stderr, "Usage: %s <contact_points> <pkey range> <ccol range> <rand seed>\n", argv[0]);
+  long long iterations = DEFAULT_ITERATIONS;
+  double rate = 0;
+  int window = 0;
+  bool prepare = false;
+  char *keydistSpec = NULL;
+  KeyDist keydist;
+  char *endptr;
+  int opt;
+
+  while (-1 != (opt = getopt_long(argc, argv, "n:r:w:pk:", long_options, NULL))) {
+    switch (opt) {
+    case 'n':
+      iterations = strtoll(optarg, &endptr, 10);
+      if ((*endptr != '\0') || (iterations < 0)) {
+	usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'r':
+      rate = strtod(optarg, &endptr);
+      if ((*endptr != '\0') || (rate <= 0)) {
+	usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'w':
+      window = atoi(optarg);
+      if (window < 1) {
+	usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'p':
+      prepare = true;
+      break;
+    case 'k':
+      keydistSpec = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (argc - optind != 4) {
+    usage(argv[0]);
     return 1;
   }
-  contact_points = argv[1];
-  char *endptr;
-  long long numkeys = strtoll(argv[2], &endptr, 10);
-  long long rowsperkey = strtoll(argv[3], &endptr, 10);
-  int seed = atoi(argv[4]);
+  contact_points = argv[optind];
+  long long numkeys = strtoll(argv[optind + 1], &endptr, 10);
+  long long rowsperkey = strtoll(argv[optind + 2], &endptr, 10);
+  int seed = atoi(argv[optind + 3]);
   struct drand48_data lcg;
   srand48_r(seed, &lcg);
+  if (0 != keydist_init(&keydist, keydistSpec, numkeys)) {
+    usage(argv[0]);
+    return 1;
+  }
 
 
   CassCluster* cluster = create_cluster(contact_points);
@@ -162,21 +365,73 @@ int main(int argc, char **argv) {
   }
 
   CassError rc = CASS_OK;
+  const CassPrepared* prepared = NULL;
   CassStatement* statement = NULL;
   CassFuture* future = NULL;
   long numResults = 0;
-  const char *tbuf;
-  size_t blen;
-  char buf[1025];
+  CsvOut out;
+
+  if (!silent && (0 != csv_out_init(&out, STDOUT_FILENO, CSV_OUT_DEFAULT_SIZE)))
+    return -1;
 
-  statement = cass_statement_new(query, 1);
+  if (prepare) {
+    if (prepare_query(session, query, &prepared) != CASS_OK) {
+      cass_session_free(session);
+      cass_cluster_free(cluster);
+      return -1;
+    }
+  }
+  statement = new_statement(query, prepared);
   long long i;
-  double rval;
   cass_int64_t val;
-  for (i = 0; i < 100000; i++) {
+  // Open loop: query i is due at t0 + i * interval, and its latency is
+  // measured from then, so a stalled request charges the queueing delay
+  // it causes to every request scheduled behind it.
+  double interval = (rate > 0) ? NANOS_PER_SEC / rate : 0;
+  Histogram *latency = malloc(sizeof(Histogram));
+  Histogram *service = malloc(sizeof(Histogram));
+  if ((NULL == latency) || (NULL == service)) {
+    fprintf(stderr, "Unable to allocate histograms\n");
+    return -1;
+  }
+  hist_init(latency);
+  hist_init(service);
+  long long intended, sent, done;
+  long long t0 = now_nanos();
+  if (window > 0) {
+    Pipeline *p = calloc(1, sizeof(Pipeline));
+    if (NULL == p) {
+      fprintf(stderr, "Unable to allocate pipeline\n");
+      return -1;
+    }
+    p->session = session;
+    p->query = query;
+    p->prepared = prepared;
+    p->iterations = iterations;
+    p->silent = silent;
+    p->interval = interval;
+    p->lcg = lcg;
+    p->keydist = keydist;
+    atomic_init(&p->numbered, 0);
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    run_pipeline(p, window, latency, service);
+    i = p->completed;
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->lock);
+    free(p);
+  }
+  else for (i = 0; i < iterations; i++) {
+    if (interval > 0) {
+      intended = t0 + (long long)(i * interval);
+      sleep_until_nanos(intended);
+      sent = now_nanos();
+    }
+    else {
+      intended = sent = now_nanos();
+    }
     numResults = 0;
-    drand48_r(&lcg, &rval);
-    val = (cass_int64_t)(rval * numkeys);
+    val = (cass_int64_t)keydist_next(&keydist, next_uniform, &lcg);
     cass_statement_bind_int64(statement, 0, val);
     future = cass_session_execute(session, statement);
     cass_future_wait(future);
@@ -187,33 +442,39 @@ int main(int argc, char **argv) {
     } 
     else {
       const CassResult* result = cass_future_get_result(future);
-      size_t nCols = cass_result_column_count(result);
-      size_t i;
-      CassIterator* iterator = cass_iterator_from_result(result);
-      
-      while (cass_true == cass_iterator_next(iterator)) {
-	if (!silent) {
-	  const CassRow* row = cass_iterator_get_row(iterator);
-	  const CassValue* val = cass_row_get_column(row, 0);
-	  printf("%s", get_column_as_string(val, buf, sizeof(buf)));
-	  for (i = 1; i < nCols; i++) {
-	    val = cass_row_get_column(row, i);
-	    printf(",%s", get_column_as_string(val, buf, sizeof(buf)));
-	  }
-	  printf("\n");
-	}
-	numResults++;
-      }
-
+      numResults = consume_result(result, silent, &out);
       cass_result_free(result);
-      cass_iterator_free(iterator);
     }
 
+    done = now_nanos();
+    hist_record(latency, done - intended);
+    hist_record(service, done - sent);
+
     fprintf(stdout, "iteration %lld: numResults = %ld\n", i, numResults);
 
     cass_future_free(future);
   }
+  double elapsed = (double)(now_nanos() - t0) / NANOS_PER_SEC;
+  fprintf(stderr, "total: %lld queries in %.3f s, %.1f QPS\n",
+	  i, elapsed, (elapsed > 0) ? i / elapsed : 0.0);
+  if (rate > 0)
+    fprintf(stderr, "target rate: %.1f QPS (open loop)\n", rate);
+  if (window > 0)
+    fprintf(stderr, "window: %d requests in flight\n", window);
+  fprintf(stderr, "statement: %s\n", prepare ? "prepared" : "unprepared");
+  fprintf(stderr, "keys: ");
+  keydist_describe(stderr, &keydist);
+  fprintf(stderr, "\n");
+  hist_print(stderr, "latency", latency);
+  if (rate > 0)
+    hist_print(stderr, "service", service);
+  free(latency);
+  free(service);
   cass_statement_free(statement);
+  if (NULL != prepared)
+    cass_prepared_free(prepared);
+  if (!silent)
+    csv_out_free(&out);
 
   close_future = cass_session_close(session);
   cass_future_wait(close_future);
@@ -1,37 +1,622 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <endian.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
-#define NUM_COLS (8)
-#define COL_RANGE (1000000)
+#include "csvout.h"
+#include "colpack.h"
+#include "keydist.h"
+#include "rowgen.h"
+#include "timing.h"
+
+// "<key>,<ccol>" plus NUM_COLS ",<value>" of at most 6 digits
+// (COL_RANGE is 1M) and a newline
+#define MAX_ROW_LEN (20 + 1 + 20 + NUM_COLS * 7 + 1)
+
+// Rows generated at a time before formatting, small enough that the
+// values are still in cache when they are formatted
+#define CSV_BLOCK_ROWS (512)
+
+/*****************************************/
+/* Parallel generation                   */
+/*                                       */
+/* Keys are cut into chunks of about     */
+/* CHUNK_ROWS rows.  Threads take chunks */
+/* in order, format them into their own  */
+/* buffer, and write them out strictly   */
+/* in chunk order, so the output does    */
+/* not depend on the thread count.       */
+/*                                       */
+/* Digits go straight into the buffer,   */
+/* sized for a whole chunk, and each     */
+/* chunk leaves in one write(2) call.    */
+/*                                       */
+/* In columnar format every field goes   */
+/* to its own file as little-endian      */
+/* int64s.  A chunk's place in each file */
+/* is known from its first row, so       */
+/* chunks are written with pwrite(2) in  */
+/* whatever order they finish.           */
+/*                                       */
+/* Packed format is columnar encoded     */
+/* with colpack: pkey delta-encoded, the */
+/* rest frame-of-reference bit-packed.   */
+/* Encoded sizes vary, so chunks are     */
+/* appended in chunk order, as for CSV.  */
+/*                                       */
+/* With --shards the keys are split into */
+/* shards exactly as Makefile.data split */
+/* them into gen runs: shard i is what   */
+/* gen <keys/shards> <rows per key> i i  */
+/* writes, into <prefix>.<i>.  One pool  */
+/* of threads works through the chunks   */
+/* of every shard in turn.  Each shard's */
+/* files are opened when its first chunk */
+/* is taken and preallocated with        */
+/* fallocate, so they are written as     */
+/* large sequential extents; the space   */
+/* left over is released when the shard  */
+/* is finished.                          */
+/*****************************************/
+
+typedef enum {
+  FORMAT_CSV,
+  FORMAT_COLUMNAR,
+  FORMAT_PACKED
+} Format;
+
+typedef struct {
+  RowGen rows;
+  int fds[NUM_FIELDS];         // CSV uses fds[0]
+  int opened;
+  long long nextWrite;         // Next chunk to write (CSV and packed)
+  long long finished;          // Chunks written
+} Shard;
+
+typedef struct {
+  Shard *shards;
+  int numShards;
+  long long chunksPerShard;
+  Format format;
+  const char *output;          // With --shards, shard i goes to <output>.<i>
+  int build;
+
+  pthread_mutex_t lock;
+  pthread_cond_t turn;
+  long long nextChunk;         // Next chunk to generate, across all shards
+  int failed;
+  int shardsDone;
+  int workersDone;
+  long long rowsDone;
+  long long bytesDone;
+} Gen;
+
+// Reserve len bytes for fd; only a layout hint, so failure is ignored.
+// exact: the file will be exactly len bytes, so extend it now.
+static void preallocate(int fd, off_t len, int exact) {
+  if (len > 0)
+    fallocate(fd, exact ? 0 : FALLOC_FL_KEEP_SIZE, 0, len);
+}
+
+/************************************************************************
+/* open_shard: create a shard's files and preallocate them; called with
+/*             the lock held.  Returns -1 on error.
+/************************************************************************/
+
+static int open_shard(Gen *g, int s) {
+  Shard *shard = &g->shards[s];
+  off_t rows = (off_t)shard->rows.numkeys * shard->rows.rowsperkey;
+  off_t blocks = (rows + COLPACK_BLOCK_ROWS - 1) / COLPACK_BLOCK_ROWS;
+  char path[4096];
+  int f;
+
+  for (f = 0; f < ((FORMAT_CSV == g->format) ? 1 : NUM_FIELDS); f++) {
+    if (FORMAT_CSV == g->format)
+      snprintf(path, sizeof(path), "%s.%d", g->output, s);
+    else
+      snprintf(path, sizeof(path), "%s.%d.%s%s", g->output, s, fieldNames[f],
+	       (FORMAT_PACKED == g->format) ? ".pk" : "");
+    shard->fds[f] = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (shard->fds[f] < 0) {
+      perror(path);
+      return -1;
+    }
+    if (FORMAT_CSV == g->format)
+      preallocate(shard->fds[f], rows * MAX_ROW_LEN, 0);
+    else if (FORMAT_COLUMNAR == g->format)
+      preallocate(shard->fds[f], rows * sizeof(int64_t), 1);
+    else
+      preallocate(shard->fds[f], blocks * COLPACK_BLOCK_BOUND(COLPACK_BLOCK_ROWS), 0);
+  }
+  shard->opened = 1;
+  return 0;
+}
+
+// Release any preallocated space past the end of the data and close
+static int close_shard(Gen *g, Shard *shard) {
+  struct stat st;
+  int f, ret = 0;
+
+  for (f = 0; f < ((FORMAT_CSV == g->format) ? 1 : NUM_FIELDS); f++) {
+    if ((0 != fstat(shard->fds[f], &st)) ||
+	(0 != ftruncate(shard->fds[f], st.st_size)) ||
+	(0 != close(shard->fds[f]))) {
+      perror("close");
+      ret = -1;
+    }
+  }
+  return ret;
+}
+
+// Note a write error; the workers share g->failed, so under the lock
+static void set_failed(Gen *g) {
+  pthread_mutex_lock(&g->lock);
+  g->failed = 1;
+  pthread_mutex_unlock(&g->lock);
+}
+
+// Count a written chunk; with --shards the last one closes the shard
+static void chunk_done(Gen *g, Shard *shard, size_t rows, size_t bytes) {
+  int done;
+
+  pthread_mutex_lock(&g->lock);
+  g->rowsDone += rows;
+  g->bytesDone += bytes;
+  done = (++shard->finished == g->chunksPerShard);
+  if (done)
+    g->shardsDone++;
+  pthread_mutex_unlock(&g->lock);
+
+  if (done && g->build && (0 != close_shard(g, shard)))
+    set_failed(g);
+}
+
+/************************************************************************
+/* gen_csv: format keys [first, last) as CSV and write them once every
+/*          earlier chunk has been written
+/************************************************************************/
+
+// Wait until every chunk of the shard before this one has been written
+static void wait_turn(Gen *g, Shard *shard, long long chunk) {
+  pthread_mutex_lock(&g->lock);
+  while (shard->nextWrite != chunk)
+    pthread_cond_wait(&g->turn, &g->lock);
+  pthread_mutex_unlock(&g->lock);
+}
+
+static void end_turn(Gen *g, Shard *shard) {
+  pthread_mutex_lock(&g->lock);
+  shard->nextWrite++;
+  pthread_cond_broadcast(&g->turn);
+  pthread_mutex_unlock(&g->lock);
+}
+
+static void gen_csv(Gen *g, Shard *shard, CsvOut *out, int64_t **fields,
+		    long long chunk, long long first, long long last, ValueStream *vs) {
+  long long rowsperkey = shard->rows.rowsperkey;
+  long long keys = (rowsperkey > 0) ? CSV_BLOCK_ROWS / rowsperkey : CSV_BLOCK_ROWS;
+  long long i, end;
+  char *p = out->buf;
+  size_t bytes, rows = 0, n, r;
+  int k;
+
+  if (keys < 1)
+    keys = 1;
+  for (i = first; i < last; i = end) {
+    end = (last - i > keys) ? i + keys : last;
+    n = rowgen_fields(&shard->rows, fields, i, end, vs);
+    for (r = 0; r < n; r++) {
+      p = csv_format_int64(p, fields[0][r]);
+      *p++ = ',';
+      p = csv_format_int64(p, fields[1][r]);
+      for (k = 2; k < NUM_FIELDS; k++) {
+	*p++ = ',';
+	p = csv_format_uint32(p, (unsigned)fields[k][r]);
+      }
+      *p++ = '\n';
+    }
+    rows += n;
+  }
+  out->len = bytes = p - out->buf;
+  out->fd = shard->fds[0];
+
+  wait_turn(g, shard, chunk);
+  if (0 != csv_out_flush(out))
+    set_failed(g);
+  end_turn(g, shard);
+  chunk_done(g, shard, rows, bytes);
+}
+
+// Write all of buf at off, retrying short writes
+static int pwrite_all(int fd, const void *buf, size_t len, off_t off) {
+  const char *p = (const char *)buf;
+
+  while (len > 0) {
+    ssize_t n = pwrite(fd, p, len, off);
+    if (n < 0) {
+      if (EINTR == errno)
+	continue;
+      perror("pwrite");
+      return -1;
+    }
+    p += n;
+    len -= n;
+    off += n;
+  }
+  return 0;
+}
+
+static int write_all(int fd, const void *buf, size_t len) {
+  const char *p = (const char *)buf;
+
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      if (EINTR == errno)
+	continue;
+      perror("write");
+      return -1;
+    }
+    p += n;
+    len -= n;
+  }
+  return 0;
+}
+
+/************************************************************************
+/* gen_columnar: generate keys [first, last) and pwrite each field to
+/*               its place in the field's file
+/************************************************************************/
+
+static void gen_columnar(Gen *g, Shard *shard, int64_t **fields, long long first,
+			 long long last, ValueStream *vs) {
+  size_t rows = rowgen_fields(&shard->rows, fields, first, last, vs);
+  off_t off = (off_t)(first - shard->rows.offset) * shard->rows.rowsperkey * sizeof(int64_t);
+  size_t r;
+  int f;
+
+  for (f = 0; f < NUM_FIELDS; f++) {
+    for (r = 0; r < rows; r++)
+      fields[f][r] = (int64_t)htole64((uint64_t)fields[f][r]);
+    if (0 != pwrite_all(shard->fds[f], fields[f], rows * sizeof(int64_t), off))
+      set_failed(g);
+  }
+  chunk_done(g, shard, rows, rows * sizeof(int64_t) * NUM_FIELDS);
+}
+
+/************************************************************************
+/* gen_packed: generate keys [first, last), encode each field in
+/*             colpack blocks, and append them in chunk order
+/************************************************************************/
+
+static void gen_packed(Gen *g, Shard *shard, int64_t **fields, uint8_t **packed,
+		       long long chunk, long long first, long long last, ValueStream *vs) {
+  size_t rows = rowgen_fields(&shard->rows, fields, first, last, vs);
+  size_t lens[NUM_FIELDS];
+  size_t bytes = 0;
+  size_t r, n;
+  int f;
+
+  for (f = 0; f < NUM_FIELDS; f++) {
+    lens[f] = 0;
+    for (r = 0; r < rows; r += n) {
+      n = rows - r;
+      if (n > COLPACK_BLOCK_ROWS)
+	n = COLPACK_BLOCK_ROWS;
+      lens[f] += colpack_encode(fields[f] + r, n,
+				(0 == f) ? COLPACK_DELTA : COLPACK_FOR,
+				packed[f] + lens[f]);
+    }
+  }
+
+  wait_turn(g, shard, chunk);
+  for (f = 0; f < NUM_FIELDS; f++) {
+    if (0 != write_all(shard->fds[f], packed[f], lens[f]))
+      set_failed(g);
+    bytes += lens[f];
+  }
+  end_turn(g, shard);
+  chunk_done(g, shard, rows, bytes);
+}
+
+static void *gen_worker(void *arg) {
+  Gen *g = (Gen *)arg;
+  size_t chunkRows = (size_t)(g->shards[0].rows.chunkKeys * g->shards[0].rows.rowsperkey);
+  long long totalChunks = g->chunksPerShard * g->numShards;
+  long long next, chunk, first, last;
+  Shard *shard;
+  int64_t *fields[NUM_FIELDS];
+  uint8_t *packed[NUM_FIELDS];
+  size_t blocks = (chunkRows + COLPACK_BLOCK_ROWS - 1) / COLPACK_BLOCK_ROWS;
+  CsvOut out;
+  ValueStream vs;
+  int f;
+
+  if (FORMAT_CSV == g->format) {
+    if (0 != csv_out_init(&out, STDOUT_FILENO, chunkRows * MAX_ROW_LEN + 1)) {
+      fprintf(stderr, "Unable to allocate chunk buffer\n");
+      exit(-1);
+    }
+  }
+  for (f = 0; f < NUM_FIELDS; f++) {
+    fields[f] = malloc((chunkRows + 1) * sizeof(int64_t));
+    packed[f] = NULL;
+    if (FORMAT_PACKED == g->format)
+      packed[f] = malloc(blocks * COLPACK_BLOCK_BOUND(COLPACK_BLOCK_ROWS));
+    if ((NULL == fields[f]) || ((FORMAT_PACKED == g->format) && (NULL == packed[f]))) {
+      fprintf(stderr, "Unable to allocate chunk buffer\n");
+      exit(-1);
+    }
+  }
+
+  for (;;) {
+    pthread_mutex_lock(&g->lock);
+    next = g->nextChunk++;
+    shard = NULL;
+    if (next < totalChunks) {
+      shard = &g->shards[next / g->chunksPerShard];
+      if (!shard->opened && (0 != open_shard(g, next / g->chunksPerShard))) {
+	// Stop handing out work
+	g->failed = 1;
+	g->nextChunk = totalChunks;
+	shard = NULL;
+      }
+    }
+    pthread_mutex_unlock(&g->lock);
+    if (NULL == shard)
+      break;
+    chunk = next % g->chunksPerShard;
+
+    rowgen_chunk(&shard->rows, chunk, &first, &last, &vs);
+
+    if (FORMAT_CSV == g->format)
+      gen_csv(g, shard, &out, fields, chunk, first, last, &vs);
+    else if (FORMAT_COLUMNAR == g->format)
+      gen_columnar(g, shard, fields, first, last, &vs);
+    else
+      gen_packed(g, shard, fields, packed, chunk, first, last, &vs);
+  }
+
+  if (FORMAT_CSV == g->format)
+    csv_out_free(&out);
+  for (f = 0; f < NUM_FIELDS; f++) {
+    free(fields[f]);
+    free(packed[f]);
+  }
+
+  pthread_mutex_lock(&g->lock);
+  g->workersDone++;
+  pthread_mutex_unlock(&g->lock);
+  return NULL;
+}
+
+/************************************************************************
+/* report_progress: print shards, rows and throughput once a second
+/*                  until every worker is done
+/************************************************************************/
+
+static void report_progress(Gen *g, int numThreads, long long t0) {
+  long long next = t0 + NANOS_PER_SEC;
+  long long now, rows, bytes;
+  int shards, workers;
+
+  for (;;) {
+    pthread_mutex_lock(&g->lock);
+    workers = g->workersDone;
+    shards = g->shardsDone;
+    rows = g->rowsDone;
+    bytes = g->bytesDone;
+    pthread_mutex_unlock(&g->lock);
+    if (workers == numThreads)
+      break;
+
+    now = now_nanos();
+    if (now >= next) {
+      double elapsed = (double)(now - t0) / NANOS_PER_SEC;
+      fprintf(stderr, "%d/%d shards, %lld rows, %.1f rows/s, %.1f MB/s\n",
+	      shards, g->numShards, rows, rows / elapsed, bytes / elapsed / 1e6);
+      next += NANOS_PER_SEC;
+    }
+    // Check for the end often, print once a second
+    sleep_until_nanos((next < now + NANOS_PER_SEC / 10) ? next : now + NANOS_PER_SEC / 10);
+  }
+}
+
+static struct option long_options[] = {
+  {"threads", required_argument, NULL, 't'},
+  {"format",  required_argument, NULL, 'f'},
+  {"output",  required_argument, NULL, 'o'},
+  {"dist",    required_argument, NULL, 'd'},
+  {"shards",  required_argument, NULL, 's'},
+  {"rng",     required_argument, NULL, 'r'},
+  {NULL,      0,                 NULL, 0}
+};
+
+static void usage(const char *prog) {
+  fprintf(stderr, "Usage %s [options] <num keys> <rows per key> <offset> <rand seed>\n", prog);
+  fprintf(stderr, "      %s [options] --shards <n> --output <prefix> <total keys> <rows per key>\n", prog);
+  fprintf(stderr, "  --threads <n>      generate with n threads (default 1, or one per CPU\n");
+  fprintf(stderr, "                     with --shards)\n");
+  fprintf(stderr, "  --format <fmt>     csv (default, to stdout), columnar or packed\n");
+  fprintf(stderr, "  --output <prefix>  columnar: write <prefix>.pkey, <prefix>.ccol,\n");
+  fprintf(stderr, "                     <prefix>.col1 .. <prefix>.col%d\n", NUM_COLS);
+  fprintf(stderr, "                     packed: the same names with a .pk suffix\n");
+  fprintf(stderr, "  --dist <dist>      distribution of column values over [0, %d):\n", COL_RANGE);
+  fprintf(stderr, "                     %s\n", KEYDIST_SPEC_HELP);
+  fprintf(stderr, "  --rng <rng>        random generator for column values:\n");
+  fprintf(stderr, "                     %s\n", ROWGEN_RNG_HELP);
+  fprintf(stderr, "  --shards <n>       build the whole dataset as n shards, shard i\n");
+  fprintf(stderr, "                     holding what <total keys / n> <rows per key> i i\n");
+  fprintf(stderr, "                     would, written to <prefix>.<i> (or with\n");
+  fprintf(stderr, "                     <prefix>.<i> as the columnar prefix)\n");
+}
 
 int main(int argc, char **argv) {
-  if (5 != argc) {
-    fprintf(stderr, "Usage %s <num keys> <rows per key> <offset> <rand seed>\n", argv[0]);
+  int numThreads = 0;
+  int numShards = 0;
+  Format format = FORMAT_CSV;
+  char *output = NULL;
+  char *dist = NULL;
+  char *rng = NULL;
+  int opt, s, t;
+
+  while (-1 != (opt = getopt_long(argc, argv, "t:f:o:d:s:r:", long_options, NULL))) {
+    switch (opt) {
+    case 't':
+      numThreads = atoi(optarg);
+      if (numThreads < 1) {
+	usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'f':
+      if (0 == strcmp(optarg, "csv"))
+	format = FORMAT_CSV;
+      else if (0 == strcmp(optarg, "columnar"))
+	format = FORMAT_COLUMNAR;
+      else if (0 == strcmp(optarg, "packed"))
+	format = FORMAT_PACKED;
+      else {
+	usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    case 'd':
+      dist = optarg;
+      break;
+    case 'r':
+      rng = optarg;
+      break;
+    case 's':
+      numShards = atoi(optarg);
+      if (numShards < 1) {
+	usage(argv[0]);
+	return 1;
+      }
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (numShards > 0) {
+    if ((2 != argc - optind) || (NULL == output)) {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  else if ((4 != argc - optind) || ((FORMAT_CSV != format) && (NULL == output))) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  Gen g;
+  memset(&g, 0, sizeof(g));
+  g.format = format;
+  g.output = output;
+  g.build = (numShards > 0);
+  g.numShards = g.build ? numShards : 1;
+  g.shards = calloc(g.numShards, sizeof(Shard));
+  if (NULL == g.shards) {
+    fprintf(stderr, "Unable to allocate shards\n");
     return 1;
   }
 
   char *endptr;
-  long long numkeys = strtoll(argv[1], &endptr, 10);
-  long long rowsperkey = strtoll(argv[2], &endptr, 10);
-  long long offset = strtoll(argv[3], &endptr, 10) * numkeys;
-  int seed = atoi(argv[4]);
-
-  struct drand48_data lcg;
-  srand48_r(seed, &lcg);
-
-  double rval;
-  long long i, j, k;
-  for (i = offset; i < offset+numkeys; i++) {
-    for (j = 0; j < rowsperkey; j++) {
-      printf("%lld,%lld", i, j);
-      for (k = 0; k < NUM_COLS; k++) {
-	drand48_r(&lcg, &rval);
-	printf(",%lld", (long long)(rval * COL_RANGE));
+  long long numkeys = strtoll(argv[optind], &endptr, 10);
+  long long rowsperkey = strtoll(argv[optind + 1], &endptr, 10);
+  if (g.build) {
+    // The same keys and seed per shard as one gen run per file
+    if ((numkeys < 0) || (0 != numkeys % numShards)) {
+      fprintf(stderr, "%lld keys do not split evenly into %d shards\n", numkeys, numShards);
+      return 1;
+    }
+    numkeys /= numShards;
+    for (s = 0; s < numShards; s++) {
+      if ((0 != rowgen_init(&g.shards[s].rows, numkeys, rowsperkey, s * numkeys, s, dist)) ||
+	  (0 != rowgen_set_rng(&g.shards[s].rows, rng))) {
+	usage(argv[0]);
+	return 1;
+      }
+    }
+    if (0 == numThreads)
+      numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  else {
+    long long offset = strtoll(argv[optind + 2], &endptr, 10) * numkeys;
+    int seed = atoi(argv[optind + 3]);
+    Shard *shard = &g.shards[0];
+
+    if ((0 != rowgen_init(&shard->rows, numkeys, rowsperkey, offset, seed, dist)) ||
+	(0 != rowgen_set_rng(&shard->rows, rng))) {
+      usage(argv[0]);
+      return 1;
+    }
+    shard->opened = 1;
+    shard->fds[0] = STDOUT_FILENO;
+    if (FORMAT_CSV != format) {
+      for (t = 0; t < NUM_FIELDS; t++) {
+	char path[4096];
+	snprintf(path, sizeof(path), "%s.%s%s", output, fieldNames[t],
+		 (FORMAT_PACKED == format) ? ".pk" : "");
+	shard->fds[t] = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (shard->fds[t] < 0) {
+	  perror(path);
+	  return 1;
+	}
       }
-      printf("\n");
     }
   }
+  if (numThreads < 1)
+    numThreads = 1;
+  g.chunksPerShard = g.shards[0].rows.numChunks;
+  pthread_mutex_init(&g.lock, NULL);
+  pthread_cond_init(&g.turn, NULL);
 
+  pthread_t *threads = malloc(numThreads * sizeof(pthread_t));
+  if (NULL == threads) {
+    fprintf(stderr, "Unable to allocate threads\n");
+    return 1;
+  }
+  long long t0 = now_nanos();
+  for (t = 0; t < numThreads; t++)
+    pthread_create(&threads[t], NULL, gen_worker, &g);
+  if (g.build)
+    report_progress(&g, numThreads, t0);
+  for (t = 0; t < numThreads; t++)
+    pthread_join(threads[t], NULL);
+  free(threads);
+
+  if (g.build) {
+    double elapsed = (double)(now_nanos() - t0) / NANOS_PER_SEC;
+    fprintf(stderr, "%d shards, %lld rows, %.1f MB in %.3f s: %.1f rows/s, %.1f MB/s with %d threads\n",
+	    g.shardsDone, g.rowsDone, g.bytesDone / 1e6, elapsed,
+	    (elapsed > 0) ? g.rowsDone / elapsed : 0.0,
+	    (elapsed > 0) ? g.bytesDone / elapsed / 1e6 : 0.0, numThreads);
+    fprintf(stderr, "rng: ");
+    rowgen_describe_rng(stderr, &g.shards[0].rows);
+    fprintf(stderr, "\n");
+  }
+  else if (FORMAT_CSV != format) {
+    for (t = 0; t < NUM_FIELDS; t++) {
+      if (0 != close(g.shards[0].fds[t]))
+	g.failed = 1;
+    }
+  }
+  free(g.shards);
+  if (g.failed)
+    return 1;
 
   return 0;
 }
@@ -0,0 +1,87 @@
+#include <stdlib.h>
+
+#include "groupmax.h"
+
+/************************************************************************
+/* group_max_init: empty table with room for capacity groups, rounded
+/*                 up to a power of two.  Returns -1 if out of memory.
+/************************************************************************/
+
+int group_max_init(GroupMax *g, uint64_t capacity) {
+  uint64_t cap = 16;
+
+  while (cap < capacity)
+    cap <<= 1;
+  g->keys = malloc(cap * sizeof(int64_t));
+  g->vals = malloc(cap * sizeof(int64_t));
+  g->used = calloc(cap, sizeof(bool));
+  g->mask = cap - 1;
+  g->count = 0;
+  if ((NULL == g->keys) || (NULL == g->vals) || (NULL == g->used)) {
+    group_max_free(g);
+    return -1;
+  }
+  return 0;
+}
+
+void group_max_free(GroupMax *g) {
+  free(g->keys);
+  free(g->vals);
+  free(g->used);
+  g->keys = g->vals = NULL;
+  g->used = NULL;
+}
+
+/************************************************************************
+/* group_max_grow: double the table and rehash every group
+/************************************************************************/
+
+int group_max_grow(GroupMax *g) {
+  GroupMax bigger;
+  uint64_t i;
+
+  if (0 != group_max_init(&bigger, (g->mask + 1) * 2))
+    return -1;
+  for (i = 0; i <= g->mask; i++) {
+    if (g->used[i])
+      group_max_add(&bigger, g->keys[i], g->vals[i]);
+  }
+  group_max_free(g);
+  *g = bigger;
+  return 0;
+}
+
+/************************************************************************
+/* group_max_merge: fold every group of src into dst; returns -1 if
+/*                  dst could not grow
+/************************************************************************/
+
+int group_max_merge(GroupMax *dst, const GroupMax *src) {
+  uint64_t i;
+
+  for (i = 0; i <= src->mask; i++) {
+    if (src->used[i] && (0 != group_max_add(dst, src->keys[i], src->vals[i])))
+      return -1;
+  }
+  return 0;
+}
+
+/************************************************************************
+/* group_max_write: one CSV row per group, "key,max" or just "max",
+/*                  in table order
+/************************************************************************/
+
+void group_max_write(CsvOut *out, const GroupMax *g, bool withKeys) {
+  uint64_t i;
+
+  for (i = 0; i <= g->mask; i++) {
+    if (!g->used[i])
+      continue;
+    if (withKeys) {
+      csv_out_int64(out, g->keys[i]);
+      csv_out_char(out, ',');
+    }
+    csv_out_int64(out, g->vals[i]);
+    csv_out_char(out, '\n');
+  }
+}
@@ -0,0 +1,67 @@
+#ifndef GROUPMAX_H
+#define GROUPMAX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "csvout.h"
+
+/*****************************************/
+/* Grouped MAX over int64 values         */
+/*                                       */
+/* Open-addressing hash table from group */
+/* key to the largest value seen, with   */
+/* linear probing and power-of-two       */
+/* sizing; it doubles at 3/4 full.       */
+/*                                       */
+/* A table belongs to one thread;        */
+/* combine them with group_max_merge     */
+/* after the threads are done.           */
+/*****************************************/
+
+#define GROUP_MAX_DEFAULT_SIZE (1 << 16)
+
+typedef struct {
+  int64_t  *keys;
+  int64_t  *vals;
+  bool     *used;
+  uint64_t  mask;              // capacity - 1
+  uint64_t  count;
+} GroupMax;
+
+int  group_max_init(GroupMax *g, uint64_t capacity);
+void group_max_free(GroupMax *g);
+int  group_max_grow(GroupMax *g);
+int  group_max_merge(GroupMax *dst, const GroupMax *src);
+void group_max_write(CsvOut *out, const GroupMax *g, bool withKeys);
+
+// Scramble sequential keys across the table (splitmix64 finalizer)
+static inline uint64_t group_max_hash(int64_t key) {
+  uint64_t x = (uint64_t)key;
+
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// Fold one (key, value) pair in; returns -1 if the table could not grow
+static inline int group_max_add(GroupMax *g, int64_t key, int64_t val) {
+  uint64_t i = group_max_hash(key) & g->mask;
+
+  while (g->used[i]) {
+    if (g->keys[i] == key) {
+      if (val > g->vals[i])
+	g->vals[i] = val;
+      return 0;
+    }
+    i = (i + 1) & g->mask;
+  }
+  g->used[i] = true;
+  g->keys[i] = key;
+  g->vals[i] = val;
+  if (++g->count > (g->mask + 1) / 4 * 3)
+    return group_max_grow(g);
+  return 0;
+}
+
+#endif
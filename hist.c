@@ -0,0 +1,93 @@
+#include <string.h>
+
+#include "hist.h"
+
+/************************************************************************
+/* hist_init: empty the histogram
+/************************************************************************/
+
+void hist_init(Histogram *h) {
+  memset(h, 0, sizeof(Histogram));
+  h->min = UINT64_MAX;
+}
+
+/************************************************************************
+/* hist_merge: add every value recorded in src to dst
+/************************************************************************/
+
+void hist_merge(Histogram *dst, const Histogram *src) {
+  int i;
+
+  for (i = 0; i < HIST_BUCKETS; i++)
+    dst->counts[i] += src->counts[i];
+  dst->total += src->total;
+  dst->sum += src->sum;
+  if (src->min < dst->min)
+    dst->min = src->min;
+  if (src->max > dst->max)
+    dst->max = src->max;
+}
+
+/************************************************************************
+/* hist_highest: largest value that maps to bucket index
+/************************************************************************/
+
+static uint64_t hist_highest(int index) {
+  int shift;
+
+  if (index < HIST_SUB_COUNT)
+    return index;
+  shift = index / HIST_HALF_COUNT - 1;
+  return (((uint64_t)(index - shift * HIST_HALF_COUNT) + 1) << shift) - 1;
+}
+
+/************************************************************************
+/* hist_percentile: value at or below which pct percent of the recorded
+/*                  values fall
+/*
+/* Returns the top of the bucket holding that value, never more than
+/* the largest value recorded.
+/************************************************************************/
+
+uint64_t hist_percentile(const Histogram *h, double pct) {
+  uint64_t target;
+  uint64_t seen = 0;
+  uint64_t value;
+  int i;
+
+  if (0 == h->total)
+    return 0;
+  target = (uint64_t)(pct / 100.0 * h->total + 0.5);
+  if (target < 1)
+    target = 1;
+  if (target > h->total)
+    target = h->total;
+
+  for (i = 0; i < HIST_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen >= target)
+      break;
+  }
+  value = hist_highest(i);
+  return (value > h->max) ? h->max : value;
+}
+
+double hist_mean(const Histogram *h) {
+  return (0 == h->total) ? 0.0 : (double)h->sum / h->total;
+}
+
+/************************************************************************
+/* hist_print: one line summary in microseconds
+/************************************************************************/
+
+void hist_print(FILE *f, const char *label, const Histogram *h) {
+  fprintf(f, "%s (us): n=%llu mean=%.1f p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f\n",
+	  label,
+	  (unsigned long long)h->total,
+	  hist_mean(h) / 1e3,
+	  hist_percentile(h, 50.0) / 1e3,
+	  hist_percentile(h, 90.0) / 1e3,
+	  hist_percentile(h, 99.0) / 1e3,
+	  hist_percentile(h, 99.9) / 1e3,
+	  (0 == h->total) ? 0.0 : h->max / 1e3);
+}
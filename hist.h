@@ -0,0 +1,67 @@
+#ifndef HIST_H
+#define HIST_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*****************************************/
+/* Log-linear latency histogram          */
+/*                                       */
+/* Values (nanoseconds) below 256 are    */
+/* counted exactly; above that every     */
+/* power of two is split into 128 equal  */
+/* buckets, so any recorded value is     */
+/* within 1/128 (0.8%) of its bucket.    */
+/* Fixed 32KB of memory covers up to     */
+/* 2^36 ns (about 68 s); larger values   */
+/* land in the top bucket but still      */
+/* count toward the max and mean.        */
+/*                                       */
+/* A histogram belongs to one thread;    */
+/* combine them with hist_merge after    */
+/* the threads are done.                 */
+/*****************************************/
+
+#define HIST_SUB_BITS (8)
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_HALF_COUNT (HIST_SUB_COUNT / 2)
+#define HIST_MAX_BITS (36)
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_HALF_COUNT + HIST_HALF_COUNT)
+
+typedef struct {
+  uint64_t counts[HIST_BUCKETS];
+  uint64_t total;
+  uint64_t sum;
+  uint64_t min;
+  uint64_t max;
+} Histogram;
+
+void     hist_init(Histogram *h);
+void     hist_merge(Histogram *dst, const Histogram *src);
+uint64_t hist_percentile(const Histogram *h, double pct);
+double   hist_mean(const Histogram *h);
+void     hist_print(FILE *f, const char *label, const Histogram *h);
+
+static inline int hist_index(uint64_t value) {
+  int shift;
+
+  if (value < HIST_SUB_COUNT)
+    return (int)value;
+  if (value >= (1ULL << HIST_MAX_BITS))
+    return HIST_BUCKETS - 1;
+  // Keep the top HIST_SUB_BITS bits of the value
+  shift = (63 - __builtin_clzll(value)) - (HIST_SUB_BITS - 1);
+  return shift * HIST_HALF_COUNT + (int)(value >> shift);
+}
+
+static inline void hist_record(Histogram *h, uint64_t value) {
+  h->counts[hist_index(value)]++;
+  h->total++;
+  h->sum += value;
+  if (value < h->min)
+    h->min = value;
+  if (value > h->max)
+    h->max = value;
+}
+
+#endif
@@ -0,0 +1,161 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "keydist.h"
+
+/*****************************************/
+/* Zipf by rejection-inversion           */
+/*                                       */
+/* Hormann and Derflinger, "Rejection-   */
+/* inversion to generate variates from   */
+/* monotone discrete distributions"      */
+/* (1996).  Ranks are 1..n; each draw    */
+/* inverts the integral of the hat       */
+/* function h(x) = x^-s, and is accepted */
+/* with probability above 0.9 for any s  */
+/* and n, so a draw is O(1) with no      */
+/* per-key tables.                       */
+/*****************************************/
+
+// log(1 + x) / x, accurate near 0
+static double helper1(double x) {
+  if (fabs(x) > 1e-8)
+    return log1p(x) / x;
+  return 1 - x * (1.0 / 2 - x * (1.0 / 3 - x / 4));
+}
+
+// (exp(x) - 1) / x, accurate near 0
+static double helper2(double x) {
+  if (fabs(x) > 1e-8)
+    return expm1(x) / x;
+  return 1 + x / 2 * (1 + x / 3 * (1 + x / 4));
+}
+
+static double zipf_h(const KeyDist *d, double x) {
+  return exp(-d->s * log(x));
+}
+
+// Integral of h from 1 to x, shifted so hIntegral(1) = 0
+static double zipf_h_integral(const KeyDist *d, double x) {
+  double logX = log(x);
+  return helper2((1 - d->s) * logX) * logX;
+}
+
+static double zipf_h_integral_inverse(const KeyDist *d, double x) {
+  double t = x * (1 - d->s);
+  if (t < -1)
+    t = -1;                    // Rounding at the edge of the domain
+  return exp(helper1(t) * x);
+}
+
+static long long zipf_next(const KeyDist *d, KeyDistRandom random, void *state) {
+  for (;;) {
+    double u = d->hIntegralN + random(state) * (d->hIntegralX1 - d->hIntegralN);
+    double x = zipf_h_integral_inverse(d, u);
+    long long k = (long long)(x + 0.5);
+
+    if (k < 1)
+      k = 1;
+    else if (k > d->n)
+      k = d->n;
+    if ((k - x <= d->threshold) ||
+	(u >= zipf_h_integral(d, k + 0.5) - zipf_h(d, k)))
+      return k - 1;
+  }
+}
+
+/************************************************************************
+/* keydist_init: set up d from spec for keys [0, n); returns -1 if the
+/*               spec is not understood
+/************************************************************************/
+
+int keydist_init(KeyDist *d, const char *spec, long long n) {
+  char *end;
+
+  memset(d, 0, sizeof(KeyDist));
+  d->n = (n > 0) ? n : 1;
+
+  if ((NULL == spec) || (0 == strcmp(spec, "uniform"))) {
+    d->type = KEYDIST_UNIFORM;
+  }
+  else if (0 == strcmp(spec, "sequential")) {
+    d->type = KEYDIST_SEQUENTIAL;
+  }
+  else if (0 == strncmp(spec, "zipf:", 5)) {
+    d->type = KEYDIST_ZIPF;
+    d->s = strtod(spec + 5, &end);
+    if ((end == spec + 5) || (*end != '\0') || !(d->s > 0))
+      return -1;
+    d->hIntegralX1 = zipf_h_integral(d, 1.5) - 1;
+    d->hIntegralN = zipf_h_integral(d, d->n + 0.5);
+    d->threshold = 2 - zipf_h_integral_inverse(d, zipf_h_integral(d, 2.5) - zipf_h(d, 2));
+  }
+  else if (0 == strncmp(spec, "hotspot:", 8)) {
+    double keys;
+    d->type = KEYDIST_HOTSPOT;
+    keys = strtod(spec + 8, &end);
+    if ((end == spec + 8) || (*end != ':'))
+      return -1;
+    d->hotDraws = strtod(end + 1, &end);
+    if ((*end != '\0') || !(keys > 0) || !(keys < 1) ||
+	(d->hotDraws < 0) || (d->hotDraws > 1))
+      return -1;
+    d->hotKeys = (long long)(keys * d->n);
+    if (d->hotKeys < 1)
+      d->hotKeys = 1;
+    if (d->hotKeys >= d->n)
+      d->hotKeys = d->n - 1;
+    if (d->hotKeys < 1)
+      return -1;
+  }
+  else {
+    return -1;
+  }
+  return 0;
+}
+
+/************************************************************************
+/* keydist_next: draw one key
+/************************************************************************/
+
+long long keydist_next(KeyDist *d, KeyDistRandom random, void *state) {
+  long long k;
+
+  switch (d->type) {
+  case KEYDIST_ZIPF:
+    return zipf_next(d, random, state);
+  case KEYDIST_HOTSPOT:
+    if (random(state) < d->hotDraws)
+      k = (long long)(random(state) * d->hotKeys);
+    else
+      k = d->hotKeys + (long long)(random(state) * (d->n - d->hotKeys));
+    return k;
+  case KEYDIST_SEQUENTIAL:
+    k = d->next;
+    d->next = (d->next + 1 < d->n) ? d->next + 1 : 0;
+    return k;
+  case KEYDIST_UNIFORM:
+  default:
+    return (long long)(random(state) * d->n);
+  }
+}
+
+void keydist_describe(FILE *f, const KeyDist *d) {
+  switch (d->type) {
+  case KEYDIST_ZIPF:
+    fprintf(f, "zipf (s = %g) over %lld keys", d->s, d->n);
+    break;
+  case KEYDIST_HOTSPOT:
+    fprintf(f, "hotspot (%lld hot keys take %.1f%% of draws) over %lld keys",
+	    d->hotKeys, 100 * d->hotDraws, d->n);
+    break;
+  case KEYDIST_SEQUENTIAL:
+    fprintf(f, "sequential over %lld keys", d->n);
+    break;
+  case KEYDIST_UNIFORM:
+  default:
+    fprintf(f, "uniform over %lld keys", d->n);
+    break;
+  }
+}
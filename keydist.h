@@ -0,0 +1,63 @@
+#ifndef KEYDIST_H
+#define KEYDIST_H
+
+#include <stdio.h>
+
+/*****************************************/
+/* Key distributions                     */
+/*                                       */
+/* Draws keys in [0, n) from a           */
+/* distribution given as a spec string:  */
+/*                                       */
+/*   uniform                             */
+/*   zipf:<s>       key k with weight    */
+/*                  1/(k+1)^s, s > 0     */
+/*   hotspot:<x>:<y> the first fraction  */
+/*                  x of keys take       */
+/*                  fraction y of draws  */
+/*   sequential     0, 1, 2, ... wrapping*/
+/*                                       */
+/* Uniform numbers come from the         */
+/* caller's generator, so each caller    */
+/* keeps its own stream and seeding.     */
+/* uniform takes exactly one number per  */
+/* key (the same key as u * n); zipf     */
+/* takes a variable number, so streams   */
+/* cannot be skipped ahead by counting.  */
+/*****************************************/
+
+#define KEYDIST_SPEC_HELP "uniform, zipf:<s>, hotspot:<key fraction>:<draw fraction> or sequential"
+
+typedef enum {
+  KEYDIST_UNIFORM,
+  KEYDIST_ZIPF,
+  KEYDIST_HOTSPOT,
+  KEYDIST_SEQUENTIAL
+} KeyDistType;
+
+// Returns a uniform double in [0, 1)
+typedef double (*KeyDistRandom)(void *state);
+
+typedef struct {
+  KeyDistType type;
+  long long   n;
+
+  // zipf (rejection-inversion)
+  double      s;
+  double      hIntegralX1;
+  double      hIntegralN;
+  double      threshold;
+
+  // hotspot
+  double      hotDraws;
+  long long   hotKeys;
+
+  // sequential
+  long long   next;
+} KeyDist;
+
+int       keydist_init(KeyDist *d, const char *spec, long long n);
+long long keydist_next(KeyDist *d, KeyDistRandom random, void *state);
+void      keydist_describe(FILE *f, const KeyDist *d);
+
+#endif
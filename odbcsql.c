@@ -3,42 +3,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
 
-/*******************************************/
-/* Macro to call ODBC functions and        */
-/* report an error on failure.             */
-/* Takes handle, handle type, and stmt     */
-/*******************************************/
-
-#define TRYODBC(h, ht, x)   {   RETCODE rc = x;		\
-    if (rc != SQL_SUCCESS)				\
-      {							\
-	HandleDiagnosticRecord (h, ht, rc);		\
-      }							\
-    if (rc == SQL_ERROR)				\
-      {							\
-	fprintf(stderr, "Error in " #x "\n");	        \
-	goto Exit;					\
-      }							\
-  }
-
-/******************************************/
-/* Forward references                     */
-/******************************************/
-
-void HandleDiagnosticRecord (SQLHANDLE      hHandle,    
-			     SQLSMALLINT    hType,  
-			     RETCODE        RetCode);
+#include "odbcutil.h"
 
-void DisplayResults(HSTMT       hStmt,
-                    SQLSMALLINT cCols,
-		    bool        silent);
+static struct option long_options[] = {
+  {"rowarray", required_argument, NULL, 'a'},
+  {NULL,       0,                 NULL, 0}
+};
 
-/*****************************************/
-/* Some constants                        */
-/*****************************************/
-#define MAXCOLS (100)
-#define BUFFERLEN (1024)
+void Usage(const char *prog)
+{
+  fprintf(stderr, "Usage: %s [--rowarray <rows per fetch>] <ConnString> <Query> [silent]\n", prog);
+}
 
 
 int main(int argc, char **argv)
@@ -49,16 +27,37 @@ int main(int argc, char **argv)
   char*       pConnStr;
   char*       pQuery;
   bool        silent = false;
+  PhaseTimes *phases = NULL;
+  long long   tPhase;
+
+  SQLULEN     rowArraySize = DEFAULT_ROW_ARRAY_SIZE;
+  char*       endptr;
+  int         opt;
+
+  while (-1 != (opt = getopt_long(argc, argv, "a:", long_options, NULL))) {
+    switch (opt) {
+    case 'a':
+      rowArraySize = strtoull(optarg, &endptr, 10);
+      if ((*endptr != '\0') || (rowArraySize < 1)) {
+	Usage(argv[0]);
+	return 1;
+      }
+      break;
+    default:
+      Usage(argv[0]);
+      return 1;
+    }
+  }
 
-  if ((argc != 3) && (argc != 4)) {
-    fprintf(stderr, "Usage: %s <ConnString> <Query> [silent>\n", argv[0]);
+  if ((argc - optind != 2) && (argc - optind != 3)) {
+    Usage(argv[0]);
     return 1;
   }
-  pConnStr = argv[1];
-  pQuery = argv[2];
-  if (4 == argc) {
-    if (0 != strncmp("silent", argv[3], 6)) {
-      fprintf(stderr, "Usage: %s <ConnString> <Query> [silent>\n", argv[0]);
+  pConnStr = argv[optind];
+  pQuery = argv[optind + 1];
+  if (argc - optind == 3) {
+    if (0 != strncmp("silent", argv[optind + 2], 6)) {
+      Usage(argv[0]);
       return 1;
     }
     else {
@@ -98,6 +97,8 @@ int main(int argc, char **argv)
   // on the input, otherwise let the driver manager prompt for input.
   if (!silent)
     fprintf(stderr, "Connecting to driver\n");
+  phases = PhaseTimesNew();
+  tPhase = now_nanos();
   TRYODBC(hDbc,
 	  SQL_HANDLE_DBC,
 	  SQLDriverConnect(hDbc,
@@ -108,6 +109,7 @@ int main(int argc, char **argv)
 			   0,
 			   NULL,
 			   SQL_DRIVER_COMPLETE));
+  PhaseRecord(phases, PHASE_CONNECT, now_nanos() - tPhase);
 
   fprintf(stderr, "Connected!\n");
 
@@ -123,7 +125,9 @@ int main(int argc, char **argv)
   // Execute the query
   if (!silent)
     fprintf(stderr, "Executing query\n");
+  tPhase = now_nanos();
   RetCode = SQLExecDirect(hStmt, pQuery, SQL_NTS);
+  PhaseRecord(phases, PHASE_EXECUTE, now_nanos() - tPhase);
 
   switch(RetCode)
     {
@@ -142,7 +146,10 @@ int main(int argc, char **argv)
 
 	if (sNumResults > 0)
 	  {
-	    DisplayResults(hStmt,sNumResults, silent);
+	    long long numReceived;
+
+	    numReceived = DisplayResults(hStmt, sNumResults, silent, rowArraySize, phases);
+	    printf("numRecieved = %lld\n", numReceived);
 	  } 
 	else
 	  {
@@ -178,6 +185,12 @@ int main(int argc, char **argv)
 
  Exit:
 
+  if (phases)
+    {
+      PhaseTimesPrint(stderr, phases);
+      free(phases);
+    }
+
   // Free ODBC handles and exit
 
   if (hStmt)
@@ -199,111 +212,3 @@ int main(int argc, char **argv)
   return 0;
 
 }
-
-/************************************************************************
-/* DisplayResults: display results of a select query
-/*
-/* Parameters:
-/*      hStmt      ODBC statement handle
-/*      cCols      Count of columns
-/************************************************************************/
-
-void DisplayResults(HSTMT       hStmt,
-                    SQLSMALLINT cCols,
-		    bool        silent)
-{
-  SQLSMALLINT     cDisplaySize;
-  RETCODE         RetCode = SQL_SUCCESS;
-  int             iCount = 0;
-  long long numReceived = 0;
-
-  // Allocate memory for each column 
-  SQLCHAR buffer[MAXCOLS][BUFFERLEN];
-  SQLLEN indPtr[MAXCOLS];
-  int iCol;
-
-  for (iCol = 0; iCol < cCols; iCol++) {
-    TRYODBC(hStmt,
-	    SQL_HANDLE_STMT,
-	    SQLBindCol(hStmt,
-		       iCol+1,
-		       SQL_C_CHAR,
-		       (SQLPOINTER) buffer[iCol],
-		       (BUFFERLEN) * sizeof(char),
-		       &indPtr[iCol]));    
-  }
-
-  // Fetch and display the data
-
-  bool fNoData = false;
-
-  do {
-    // Fetch a row
-
-    TRYODBC(hStmt, SQL_HANDLE_STMT, RetCode = SQLFetch(hStmt));
-
-    if (RetCode == SQL_NO_DATA_FOUND)
-      {
-	fNoData = true;
-      }
-    else
-      {
-	if (!silent) {
-	  // Display the data.   Ignore truncations	
-	  printf("%s", buffer[0]);
-	  for (iCol = 1; iCol < cCols; iCol++) {
-	    printf(",%s", buffer[iCol]);
-	  }
-	  printf("\n");
-	}
-
-	numReceived++;
-      }
-  } while (!fNoData);
-
- Exit:
-  printf("numRecieved = %lld\n", numReceived);
-}
-
-/************************************************************************
-/* HandleDiagnosticRecord : display error/warning information
-/*
-/* Parameters:
-/*      hHandle     ODBC handle
-/*      hType       Type of handle (HANDLE_STMT, HANDLE_ENV, HANDLE_DBC)
-/*      RetCode     Return code of failing command
-/************************************************************************/
-
-void HandleDiagnosticRecord (SQLHANDLE      hHandle,    
-                             SQLSMALLINT    hType,  
-                             RETCODE        RetCode)
-{
-  SQLSMALLINT iRec = 0;
-  SQLINTEGER  iError;
-  char        message[1000];
-  char        state[SQL_SQLSTATE_SIZE+1];
-
-
-  if (RetCode == SQL_INVALID_HANDLE)
-    {
-      fprintf(stderr, "Invalid handle!\n");
-      return;
-    }
-
-  while (SQLGetDiagRec(hType,
-		       hHandle,
-		       ++iRec,
-		       state,
-		       &iError,
-		       message,
-		       (SQLSMALLINT)(sizeof(message) / sizeof(WCHAR)),
-		       (SQLSMALLINT *)NULL) == SQL_SUCCESS)
-    {
-      // Hide data truncated..
-      if (strncmp(state, "01004", 5))
-        {
-	  fprintf(stderr, "[%5.5s] %s (%d)\n", state, message, iError);
-        }
-    }
-
-}
@@ -0,0 +1,480 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "odbcutil.h"
+#include "csvout.h"
+
+// Output buffer shared by every DisplayResults call on a thread
+static __thread CsvOut out;
+
+/************************************************************************
+/* BindResultColumns: describe and bind the columns of a result set
+/*
+/* Each column is described with SQLDescribeCol and bound to an array of
+/* rowArraySize elements of its native C type: integer columns as
+/* SQL_C_SBIGINT, floating point columns as SQL_C_DOUBLE, and everything
+/* else as SQL_C_CHAR sized from the reported column size (capped at
+/* BUFFERLEN).
+/*
+/* Parameters:
+/*      hStmt          ODBC statement handle
+/*      cCols          Count of columns
+/*      rowArraySize   Elements per bound array
+/*      cols           Array of cCols column descriptors to fill in
+/*      pNextCol       First column still to bind, 0 on the first call
+/*
+/* Returns SQL_SUCCESS, SQL_STILL_EXECUTING if an asynchronous
+/* SQLDescribeCol has not finished (call again to poll it, *pNextCol
+/* says where to pick up), or SQL_ERROR after reporting the failure.  On
+/* failure the caller must still call FreeResultColumns.
+/************************************************************************/
+
+RETCODE BindResultColumns(HSTMT        hStmt,
+			  SQLSMALLINT  cCols,
+			  SQLULEN      rowArraySize,
+			  BoundColumn *cols,
+			  int         *pNextCol)
+{
+  SQLCHAR     colName[256];
+  SQLSMALLINT colNameLen;
+  SQLSMALLINT sqlType;
+  SQLULEN     colSize;
+  SQLSMALLINT decimalDigits;
+  SQLSMALLINT nullable;
+  int         iCol;
+
+  if (0 == *pNextCol)
+    memset(cols, 0, cCols * sizeof(BoundColumn));
+
+  for (iCol = *pNextCol; iCol < cCols; iCol++) {
+    RETCODE RetCode;
+
+    RetCode = SQLDescribeCol(hStmt,
+			     iCol+1,
+			     colName,
+			     sizeof(colName),
+			     &colNameLen,
+			     &sqlType,
+			     &colSize,
+			     &decimalDigits,
+			     &nullable);
+    if (SQL_STILL_EXECUTING == RetCode) {
+      *pNextCol = iCol;
+      return RetCode;
+    }
+    TRYODBC(hStmt, SQL_HANDLE_STMT, RetCode);
+
+    switch (sqlType) {
+    case SQL_BIGINT:
+    case SQL_INTEGER:
+    case SQL_SMALLINT:
+    case SQL_TINYINT:
+      cols[iCol].cType = SQL_C_SBIGINT;
+      cols[iCol].width = sizeof(SQLBIGINT);
+      break;
+    case SQL_DOUBLE:
+    case SQL_FLOAT:
+    case SQL_REAL:
+      cols[iCol].cType = SQL_C_DOUBLE;
+      cols[iCol].width = sizeof(SQLDOUBLE);
+      break;
+    case SQL_BINARY:
+    case SQL_VARBINARY:
+      // Hex encoded, two characters per byte
+      cols[iCol].cType = SQL_C_CHAR;
+      cols[iCol].width = 2 * colSize + 1;
+      break;
+    case SQL_WCHAR:
+    case SQL_WVARCHAR:
+      // Up to four bytes per character once converted
+      cols[iCol].cType = SQL_C_CHAR;
+      cols[iCol].width = 4 * colSize + 1;
+      break;
+    default:
+      // Room for sign, decimal point and terminator on numerics
+      cols[iCol].cType = SQL_C_CHAR;
+      cols[iCol].width = colSize + 3;
+      break;
+    }
+    if ((0 == colSize) || (cols[iCol].width > BUFFERLEN))
+      cols[iCol].width = BUFFERLEN;
+
+    cols[iCol].data = malloc(rowArraySize * cols[iCol].width);
+    cols[iCol].ind = malloc(rowArraySize * sizeof(SQLLEN));
+    if ((NULL == cols[iCol].data) || (NULL == cols[iCol].ind)) {
+      fprintf(stderr, "Unable to allocate column buffers\n");
+      return SQL_ERROR;
+    }
+
+    TRYODBC(hStmt,
+	    SQL_HANDLE_STMT,
+	    SQLBindCol(hStmt,
+		       iCol+1,
+		       cols[iCol].cType,
+		       cols[iCol].data,
+		       cols[iCol].width,
+		       cols[iCol].ind));
+  }
+
+  *pNextCol = cCols;
+  return SQL_SUCCESS;
+
+ Exit:
+  return SQL_ERROR;
+}
+
+/************************************************************************
+/* FreeResultColumns: unbind and release the buffers from
+/*                    BindResultColumns
+/************************************************************************/
+
+void FreeResultColumns(HSTMT        hStmt,
+		       SQLSMALLINT  cCols,
+		       BoundColumn *cols)
+{
+  int iCol;
+
+  SQLFreeStmt(hStmt, SQL_UNBIND);
+  for (iCol = 0; iCol < cCols; iCol++) {
+    free(cols[iCol].data);
+    free(cols[iCol].ind);
+    cols[iCol].data = NULL;
+    cols[iCol].ind = NULL;
+  }
+}
+
+/************************************************************************
+/* ResultSetOpen: bind a result set for block fetches
+/*
+/* Every column is bound to an array of rowArraySize elements
+/* (column-wise binding) so that a single SQLFetch returns up to
+/* rowArraySize rows.  A rowArraySize of 1 behaves like the classic
+/* one-row-per-SQLFetch loop.
+/*
+/* Parameters:
+/*      rs             Result set to fill in
+/*      hStmt          ODBC statement handle
+/*      cCols          Count of columns
+/*      silent         Count the rows without printing them
+/*      rowArraySize   Rows per SQLFetch
+/*      phases         Where to record bind/fetch/format time, or NULL
+/*
+/* Returns SQL_SUCCESS, SQL_STILL_EXECUTING if the columns of an
+/* asynchronous statement are still being described (poll with
+/* ResultSetBind), or SQL_ERROR after reporting the failure.  Either way
+/* the caller must call ResultSetClose.
+/************************************************************************/
+
+RETCODE ResultSetOpen(ResultSet   *rs,
+		      HSTMT        hStmt,
+		      SQLSMALLINT  cCols,
+		      bool         silent,
+		      SQLULEN      rowArraySize,
+		      PhaseTimes  *phases)
+{
+  long long t0 = now_nanos();
+
+  memset(rs, 0, sizeof(ResultSet));
+  rs->hStmt = hStmt;
+  rs->silent = silent;
+  rs->phases = phases;
+  rs->rowArraySize = (rowArraySize < 1) ? 1 : rowArraySize;
+
+  if (cCols > MAXCOLS) {
+    fprintf(stderr, "Too many columns (%d), max is %d\n", cCols, MAXCOLS);
+    return SQL_ERROR;
+  }
+
+  rs->cols = calloc(cCols, sizeof(BoundColumn));
+  rs->rowStatus = malloc(rs->rowArraySize * sizeof(SQLUSMALLINT));
+  if ((NULL == rs->cols) || (NULL == rs->rowStatus)) {
+    fprintf(stderr, "Unable to allocate result buffers\n");
+    return SQL_ERROR;
+  }
+  rs->cCols = cCols;
+  if (!silent) {
+    if ((NULL == out.buf) && (0 != csv_out_init(&out, STDOUT_FILENO, CSV_OUT_DEFAULT_SIZE)))
+      return SQL_ERROR;
+    // Rows bypass stdio, so anything already printf'd must go first
+    fflush(stdout);
+  }
+
+  TRYODBC(hStmt,
+	  SQL_HANDLE_STMT,
+	  SQLSetStmtAttr(hStmt,
+			 SQL_ATTR_ROW_BIND_TYPE,
+			 (SQLPOINTER)SQL_BIND_BY_COLUMN,
+			 0));
+  TRYODBC(hStmt,
+	  SQL_HANDLE_STMT,
+	  SQLSetStmtAttr(hStmt,
+			 SQL_ATTR_ROW_ARRAY_SIZE,
+			 (SQLPOINTER)rs->rowArraySize,
+			 0));
+  TRYODBC(hStmt,
+	  SQL_HANDLE_STMT,
+	  SQLSetStmtAttr(hStmt,
+			 SQL_ATTR_ROWS_FETCHED_PTR,
+			 (SQLPOINTER)&rs->numFetched,
+			 0));
+  TRYODBC(hStmt,
+	  SQL_HANDLE_STMT,
+	  SQLSetStmtAttr(hStmt,
+			 SQL_ATTR_ROW_STATUS_PTR,
+			 (SQLPOINTER)rs->rowStatus,
+			 0));
+
+  rs->bindStart = t0;
+  return ResultSetBind(rs);
+
+ Exit:
+  return SQL_ERROR;
+}
+
+/************************************************************************
+/* ResultSetBind: describe and bind the columns ResultSetOpen has not
+/*                got to yet
+/*
+/* Returns SQL_SUCCESS once every column is bound, SQL_STILL_EXECUTING
+/* if an asynchronous SQLDescribeCol has not finished (call again to
+/* poll it), or SQL_ERROR after reporting the failure.
+/************************************************************************/
+
+RETCODE ResultSetBind(ResultSet *rs)
+{
+  RETCODE RetCode;
+
+  RetCode = BindResultColumns(rs->hStmt, rs->cCols, rs->rowArraySize, rs->cols,
+			      &rs->numBound);
+  if (SQL_SUCCESS == RetCode)
+    PhaseRecord(rs->phases, PHASE_BIND, now_nanos() - rs->bindStart);
+  return RetCode;
+}
+
+/************************************************************************
+/* ResultSetFetch: one SQLFetch, and display the block it returns
+/*
+/* Values stay in their native C type and are only formatted when they
+/* are displayed, straight into a buffered CSV writer that is flushed by
+/* ResultSetClose.
+/*
+/* Returns SQL_SUCCESS when a block was fetched, SQL_NO_DATA at the end,
+/* SQL_STILL_EXECUTING if an asynchronous fetch has not finished (call
+/* again to poll it), or SQL_ERROR after reporting the failure.
+/************************************************************************/
+
+RETCODE ResultSetFetch(ResultSet *rs)
+{
+  BoundColumn *cols = rs->cols;
+  RETCODE      RetCode;
+  long long    t0, t1;
+  SQLULEN      iRow;
+  int          iCol;
+
+  if (0 == rs->fetchStart)
+    rs->fetchStart = now_nanos();
+  RetCode = SQLFetch(rs->hStmt);
+  if (SQL_STILL_EXECUTING == RetCode)
+    return RetCode;
+  t0 = now_nanos();
+  PhaseRecord(rs->phases, PHASE_FETCH, t0 - rs->fetchStart);
+  rs->fetchStart = 0;
+
+  if (SQL_NO_DATA == RetCode)
+    return RetCode;
+  if (SQL_SUCCESS != RetCode)
+    HandleDiagnosticRecord(rs->hStmt, SQL_HANDLE_STMT, RetCode);
+  if (SQL_ERROR == RetCode) {
+    fprintf(stderr, "Error in SQLFetch\n");
+    return RetCode;
+  }
+
+  for (iRow = 0; iRow < rs->numFetched; iRow++) {
+    if ((rs->rowStatus[iRow] != SQL_ROW_SUCCESS) &&
+	(rs->rowStatus[iRow] != SQL_ROW_SUCCESS_WITH_INFO))
+      continue;
+
+    if (!rs->silent) {
+      // Display the data.   Ignore truncations
+      for (iCol = 0; iCol < rs->cCols; iCol++) {
+	if (0 != iCol)
+	  csv_out_char(&out, ',');
+	if (cols[iCol].ind[iRow] == SQL_NULL_DATA)
+	  continue;
+	switch (cols[iCol].cType) {
+	case SQL_C_SBIGINT:
+	  csv_out_int64(&out, ((SQLBIGINT *)cols[iCol].data)[iRow]);
+	  break;
+	case SQL_C_DOUBLE:
+	  csv_out_double(&out, ((SQLDOUBLE *)cols[iCol].data)[iRow]);
+	  break;
+	default:
+	  {
+	    char *pVal = (char *)cols[iCol].data + iRow * cols[iCol].width;
+	    csv_out_text(&out, pVal, strnlen(pVal, cols[iCol].width));
+	  }
+	  break;
+	}
+      }
+      csv_out_char(&out, '\n');
+    }
+
+    rs->numReceived++;
+  }
+  t1 = now_nanos();
+  PhaseRecord(rs->phases, PHASE_FORMAT, t1 - t0);
+  return SQL_SUCCESS;
+}
+
+/************************************************************************
+/* ResultSetClose: unbind, flush the output and free the buffers
+/*
+/* Returns the number of rows received.
+/************************************************************************/
+
+long long ResultSetClose(ResultSet *rs)
+{
+  // The bound buffers go away with this call, so drop the bindings
+  if (NULL != rs->cols)
+    FreeResultColumns(rs->hStmt, rs->cCols, rs->cols);
+  SQLSetStmtAttr(rs->hStmt, SQL_ATTR_ROWS_FETCHED_PTR, NULL, 0);
+  SQLSetStmtAttr(rs->hStmt, SQL_ATTR_ROW_STATUS_PTR, NULL, 0);
+
+  if (!rs->silent && (NULL != out.buf))
+    csv_out_flush(&out);
+  free(rs->cols);
+  free(rs->rowStatus);
+  rs->cols = NULL;
+  rs->rowStatus = NULL;
+
+  return rs->numReceived;
+}
+
+/************************************************************************
+/* DisplayResults: display results of a select query on a synchronous
+/*                 statement
+/*
+/* Parameters:
+/*      hStmt          ODBC statement handle
+/*      cCols          Count of columns
+/*      silent         Count the rows without printing them
+/*      rowArraySize   Rows per SQLFetch
+/*      phases         Where to record bind/fetch/format time, or NULL
+/*
+/* Returns the number of rows received.
+/************************************************************************/
+
+long long DisplayResults(HSTMT       hStmt,
+			 SQLSMALLINT cCols,
+			 bool        silent,
+			 SQLULEN     rowArraySize,
+			 PhaseTimes *phases)
+{
+  ResultSet rs;
+
+  if (SQL_SUCCESS == ResultSetOpen(&rs, hStmt, cCols, silent, rowArraySize, phases)) {
+    while (SQL_SUCCESS == ResultSetFetch(&rs))
+      ;
+  }
+  return ResultSetClose(&rs);
+}
+
+/************************************************************************
+/* PhaseTimesNew: allocate an empty set of phase histograms
+/************************************************************************/
+
+PhaseTimes *PhaseTimesNew(void)
+{
+  PhaseTimes *phases = malloc(sizeof(PhaseTimes));
+  int         i;
+
+  if (NULL == phases) {
+    fprintf(stderr, "Unable to allocate phase timers\n");
+    return NULL;
+  }
+  for (i = 0; i < NUM_PHASES; i++)
+    hist_init(&phases->hist[i]);
+  return phases;
+}
+
+void PhaseTimesMerge(PhaseTimes *dst, const PhaseTimes *src)
+{
+  int i;
+
+  for (i = 0; i < NUM_PHASES; i++)
+    hist_merge(&dst->hist[i], &src->hist[i]);
+}
+
+/************************************************************************
+/* PhaseTimesPrint: table of calls, total and per-call percentiles for
+/*                  every phase that was timed
+/************************************************************************/
+
+void PhaseTimesPrint(FILE *f, const PhaseTimes *phases)
+{
+  static const char *names[NUM_PHASES] = {
+    "connect", "prepare", "execute", "bind", "fetch", "format", "commit"
+  };
+  int i;
+
+  fprintf(f, "%-8s %10s %12s %10s %10s %10s %10s %10s\n",
+	  "phase", "calls", "total(ms)", "mean(us)", "p50(us)", "p99(us)", "p99.9(us)", "max(us)");
+  for (i = 0; i < NUM_PHASES; i++) {
+    const Histogram *h = &phases->hist[i];
+    if (0 == h->total)
+      continue;
+    fprintf(f, "%-8s %10llu %12.3f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+	    names[i],
+	    (unsigned long long)h->total,
+	    h->sum / 1e6,
+	    hist_mean(h) / 1e3,
+	    hist_percentile(h, 50.0) / 1e3,
+	    hist_percentile(h, 99.0) / 1e3,
+	    hist_percentile(h, 99.9) / 1e3,
+	    h->max / 1e3);
+  }
+}
+
+/************************************************************************
+/* HandleDiagnosticRecord : display error/warning information
+/*
+/* Parameters:
+/*      hHandle     ODBC handle
+/*      hType       Type of handle (HANDLE_STMT, HANDLE_ENV, HANDLE_DBC)
+/*      RetCode     Return code of failing command
+/************************************************************************/
+
+void HandleDiagnosticRecord (SQLHANDLE      hHandle,
+                             SQLSMALLINT    hType,
+                             RETCODE        RetCode)
+{
+  SQLSMALLINT iRec = 0;
+  SQLINTEGER  iError;
+  char        message[1000];
+  char        state[SQL_SQLSTATE_SIZE+1];
+
+
+  if (RetCode == SQL_INVALID_HANDLE)
+    {
+      fprintf(stderr, "Invalid handle!\n");
+      return;
+    }
+
+  while (SQLGetDiagRec(hType,
+		       hHandle,
+		       ++iRec,
+		       state,
+		       &iError,
+		       message,
+		       (SQLSMALLINT)(sizeof(message) / sizeof(WCHAR)),
+		       (SQLSMALLINT *)NULL) == SQL_SUCCESS)
+    {
+      // Hide data truncated..
+      if (strncmp(state, "01004", 5))
+        {
+	  fprintf(stderr, "[%5.5s] %s (%d)\n", state, message, iError);
+        }
+    }
+
+}
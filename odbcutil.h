@@ -0,0 +1,143 @@
+#ifndef ODBCUTIL_H
+#define ODBCUTIL_H
+
+#include <sql.h>
+#include <sqlext.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "hist.h"
+#include "timing.h"
+
+/*******************************************/
+/* Macro to call ODBC functions and        */
+/* report an error on failure.             */
+/* Takes handle, handle type, and stmt     */
+/*******************************************/
+
+#define TRYODBC(h, ht, x)   {   RETCODE rc = x;		\
+    if (rc != SQL_SUCCESS)				\
+      {							\
+	HandleDiagnosticRecord (h, ht, rc);		\
+      }							\
+    if (rc == SQL_ERROR)				\
+      {							\
+	fprintf(stderr, "Error in " #x "\n");	        \
+	goto Exit;					\
+      }							\
+  }
+
+/*****************************************/
+/* Some constants                        */
+/*****************************************/
+#define MAXCOLS (100)
+#define BUFFERLEN (1024)
+#define DEFAULT_ROW_ARRAY_SIZE (1)
+
+/*****************************************/
+/* A result column bound to an array of  */
+/* rowArraySize elements of its C type   */
+/*****************************************/
+typedef struct {
+  SQLSMALLINT cType;    // SQL_C_SBIGINT, SQL_C_DOUBLE or SQL_C_CHAR
+  SQLLEN      width;    // Bytes per element
+  SQLPOINTER  data;     // rowArraySize elements
+  SQLLEN     *ind;      // rowArraySize length/indicator values
+} BoundColumn;
+
+/*****************************************/
+/* Client-side time spent in each phase  */
+/* of a query.  One sample per call:     */
+/* per connection, per SQLPrepare, per   */
+/* execute, per result set bound, per    */
+/* SQLFetch, per block formatted and per */
+/* SQLEndTran.                           */
+/*****************************************/
+typedef enum {
+  PHASE_CONNECT,
+  PHASE_PREPARE,
+  PHASE_EXECUTE,
+  PHASE_BIND,
+  PHASE_FETCH,
+  PHASE_FORMAT,
+  PHASE_COMMIT,
+  NUM_PHASES
+} Phase;
+
+typedef struct {
+  Histogram hist[NUM_PHASES];
+} PhaseTimes;
+
+// Record a sample; phases may be NULL when timing is not wanted
+static inline void PhaseRecord(PhaseTimes *phases, Phase phase, long long nanos)
+{
+  if (NULL != phases)
+    hist_record(&phases->hist[phase], nanos);
+}
+
+/*****************************************/
+/* A result set being fetched a block    */
+/* at a time.  ResultSetFetch makes one  */
+/* SQLFetch call, so on an asynchronous  */
+/* statement the caller can poll it      */
+/* alongside other work.  The struct is  */
+/* bound as the rows-fetched pointer and */
+/* must not move while it is open.       */
+/*****************************************/
+typedef struct {
+  HSTMT         hStmt;
+  SQLSMALLINT   cCols;
+  SQLULEN       rowArraySize;
+  bool          silent;
+  PhaseTimes   *phases;
+  BoundColumn  *cols;
+  SQLUSMALLINT *rowStatus;
+  SQLULEN       numFetched;
+  int           numBound;       // Columns described and bound so far
+  long long     bindStart;
+  long long     numReceived;
+  long long     fetchStart;     // First call of the pending SQLFetch, or 0
+} ResultSet;
+
+/******************************************/
+/* Shared routines (odbcutil.c)           */
+/******************************************/
+
+void HandleDiagnosticRecord (SQLHANDLE      hHandle,
+			     SQLSMALLINT    hType,
+			     RETCODE        RetCode);
+
+RETCODE BindResultColumns(HSTMT        hStmt,
+			  SQLSMALLINT  cCols,
+			  SQLULEN      rowArraySize,
+			  BoundColumn *cols,
+			  int         *pNextCol);
+
+void FreeResultColumns(HSTMT        hStmt,
+		       SQLSMALLINT  cCols,
+		       BoundColumn *cols);
+
+RETCODE ResultSetOpen(ResultSet   *rs,
+		      HSTMT        hStmt,
+		      SQLSMALLINT  cCols,
+		      bool         silent,
+		      SQLULEN      rowArraySize,
+		      PhaseTimes  *phases);
+
+RETCODE ResultSetBind(ResultSet *rs);
+
+RETCODE ResultSetFetch(ResultSet *rs);
+
+long long ResultSetClose(ResultSet *rs);
+
+long long DisplayResults(HSTMT       hStmt,
+			 SQLSMALLINT cCols,
+			 bool        silent,
+			 SQLULEN     rowArraySize,
+			 PhaseTimes *phases);
+
+PhaseTimes *PhaseTimesNew(void);
+void PhaseTimesMerge(PhaseTimes *dst, const PhaseTimes *src);
+void PhaseTimesPrint(FILE *f, const PhaseTimes *phases);
+
+#endif
@@ -0,0 +1,680 @@
+#include <sql.h>
+#include <sqlext.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "odbcutil.h"
+#include "csvin.h"
+#include "rowgen.h"
+#include "timing.h"
+#include "hist.h"
+
+/*****************************************/
+/* Bulk loader for otest.test10          */
+/*                                       */
+/* Rows come from CSV files (one file at */
+/* a time per connection) or straight    */
+/* from the generator (one chunk at a    */
+/* time, the same rows gen writes).      */
+/* Every connection prepares one INSERT  */
+/* and binds each column to an array of  */
+/* SQL_C_SBIGINT, so one SQLExecute      */
+/* sends a whole batch of rows.          */
+/*****************************************/
+
+#define DEFAULT_BATCH_SIZE (1000)
+#define DEFAULT_LOAD_THREADS (1)
+#define DEFAULT_TABLE "otest.test10"
+
+/*****************************************/
+/* Settings shared by every worker       */
+/*****************************************/
+typedef struct {
+  SQLHENV      hEnv;
+  char        *pConnStr;
+  char         insert[BUFFERLEN];
+  SQLULEN      batchSize;
+  long long    commitRows;      // Rows per transaction, 0 for autocommit
+  int          numThreads;
+  bool         fromGen;
+  RowGen       rows;            // --gen
+  char       **files;           // Otherwise CSV files, "-" for stdin
+  int          numFiles;
+
+  pthread_mutex_t lock;
+  long long    next;            // Next chunk or file to load
+  pthread_barrier_t start;      // Workers connect, then start together
+} OLoadConfig;
+
+/*****************************************/
+/* One connection and its bound arrays   */
+/*****************************************/
+typedef struct {
+  OLoadConfig  *config;
+  int           id;
+  pthread_t     thread;
+  SQLHDBC       hDbc;
+  SQLHSTMT      hStmt;
+
+  int64_t      *fields[NUM_FIELDS];  // capacity rows each
+  size_t        capacity;
+  SQLUSMALLINT *paramStatus;         // batchSize
+  SQLULEN       processed;
+  SQLULEN       boundSize;           // Current SQL_ATTR_PARAMSET_SIZE
+  long long     uncommitted;
+
+  long long     pending;             // Loaded, awaiting the commit
+  long long     loaded;
+  long long     rolledBack;          // Discarded with the open transaction
+  long long     failed;
+  long long     unused;              // Not processed, e.g. after an error
+  long long     unknown;             // Driver gave no status
+  double        elapsed;
+  int           status;
+  PhaseTimes   *phases;
+} OLoadWorker;
+
+static struct option long_options[] = {
+  {"threads", required_argument, NULL, 't'},
+  {"batch",   required_argument, NULL, 'b'},
+  {"commit",  required_argument, NULL, 'c'},
+  {"table",   required_argument, NULL, 'T'},
+  {"gen",     no_argument,       NULL, 'g'},
+  {"dist",    required_argument, NULL, 'd'},
+  {"rng",     required_argument, NULL, 'r'},
+  {NULL,      0,                 NULL, 0}
+};
+
+static void Usage(const char *prog)
+{
+  fprintf(stderr, "Usage: %s [options] <ConnString> <csv file>...\n", prog);
+  fprintf(stderr, "       %s [options] --gen <ConnString> <num keys> <rows per key> <offset> <rand seed>\n", prog);
+  fprintf(stderr, "  --threads <n>      connections (default %d)\n", DEFAULT_LOAD_THREADS);
+  fprintf(stderr, "  --batch <rows>     rows per SQLExecute (default %d)\n", DEFAULT_BATCH_SIZE);
+  fprintf(stderr, "  --commit <rows>    rows per transaction, 0 for autocommit (default 0)\n");
+  fprintf(stderr, "  --table <name>     table to load (default %s)\n", DEFAULT_TABLE);
+  fprintf(stderr, "  --gen              generate the rows gen would write instead of reading CSV\n");
+  fprintf(stderr, "  --dist <dist>      with --gen, distribution of column values: %s\n", KEYDIST_SPEC_HELP);
+  fprintf(stderr, "  --rng <rng>        with --gen, random generator: %s\n", ROWGEN_RNG_HELP);
+}
+
+/************************************************************************
+/* BindBatch: bind every parameter to its column array starting at row
+/*            r, with n rows per execute
+/************************************************************************/
+
+static RETCODE BindBatch(OLoadWorker *worker, size_t r, SQLULEN n)
+{
+  SQLHSTMT hStmt = worker->hStmt;
+  int      f;
+
+  if (n != worker->boundSize) {
+    TRYODBC(hStmt,
+	    SQL_HANDLE_STMT,
+	    SQLSetStmtAttr(hStmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)n, 0));
+    worker->boundSize = n;
+  }
+  for (f = 0; f < NUM_FIELDS; f++) {
+    TRYODBC(hStmt,
+	    SQL_HANDLE_STMT,
+	    SQLBindParameter(hStmt, f + 1, SQL_PARAM_INPUT, SQL_C_SBIGINT, SQL_BIGINT,
+			     0, 0, worker->fields[f] + r, sizeof(int64_t), NULL));
+  }
+  return SQL_SUCCESS;
+
+ Exit:
+  return SQL_ERROR;
+}
+
+/************************************************************************
+/* Commit: end the open transaction
+/************************************************************************/
+
+static RETCODE Commit(OLoadWorker *worker)
+{
+  long long tPhase = now_nanos();
+
+  TRYODBC(worker->hDbc,
+	  SQL_HANDLE_DBC,
+	  SQLEndTran(SQL_HANDLE_DBC, worker->hDbc, SQL_COMMIT));
+  PhaseRecord(worker->phases, PHASE_COMMIT, now_nanos() - tPhase);
+  worker->uncommitted = 0;
+  worker->loaded += worker->pending;
+  worker->pending = 0;
+  return SQL_SUCCESS;
+
+ Exit:
+  return SQL_ERROR;
+}
+
+/************************************************************************
+/* CountStatus: tally the n rows of the batch just executed from the
+/*              parameter status array
+/*
+/* Only SQL_PARAM_SUCCESS and SQL_PARAM_SUCCESS_WITH_INFO rows count as
+/* loaded, and with --commit only once Commit has succeeded; until then
+/* they are pending.  Rows past the processed count, or marked SQL_PARAM_UNUSED
+/* because the driver stopped at an error, are unused.  The array is
+/* preset to SQL_PARAM_DIAG_UNAVAILABLE, so a driver that does not fill
+/* it in gets all rows loaded on SQL_SUCCESS and unknown otherwise.
+/************************************************************************/
+
+static void CountStatus(OLoadWorker *worker, SQLULEN n, RETCODE RetCode)
+{
+  SQLULEN processed = (worker->processed < n) ? worker->processed : n;
+  SQLULEN i;
+
+  for (i = 0; i < processed; i++) {
+    switch (worker->paramStatus[i]) {
+    case SQL_PARAM_SUCCESS:
+    case SQL_PARAM_SUCCESS_WITH_INFO:
+      worker->pending++;
+      break;
+    case SQL_PARAM_ERROR:
+      worker->failed++;
+      break;
+    case SQL_PARAM_UNUSED:
+      worker->unused++;
+      break;
+    default:
+      if (SQL_SUCCESS == RetCode)
+	worker->pending++;
+      else
+	worker->unknown++;
+      break;
+    }
+  }
+  worker->unused += n - processed;
+  if (0 == worker->config->commitRows) {
+    worker->loaded += worker->pending;
+    worker->pending = 0;
+  }
+}
+
+/************************************************************************
+/* SendRows: insert the first rows rows of the bound arrays, batchSize
+/*           rows per SQLExecute, committing every commitRows rows
+/*
+/* Rows the driver reports as failed in the parameter status array are
+/* counted, not retried.
+/************************************************************************/
+
+static RETCODE SendRows(OLoadWorker *worker, size_t rows)
+{
+  OLoadConfig *config = worker->config;
+  long long    tPhase;
+  RETCODE      RetCode;
+  size_t       r;
+  SQLULEN      n, i;
+
+  for (r = 0; r < rows; r += n) {
+    n = rows - r;
+    if (n > config->batchSize)
+      n = config->batchSize;
+
+    tPhase = now_nanos();
+    if (SQL_SUCCESS != BindBatch(worker, r, n))
+      return SQL_ERROR;
+    PhaseRecord(worker->phases, PHASE_BIND, now_nanos() - tPhase);
+
+    // In case the driver does not fill in SQL_ATTR_PARAMS_PROCESSED_PTR
+    // or the status array
+    worker->processed = n;
+    for (i = 0; i < n; i++)
+      worker->paramStatus[i] = SQL_PARAM_DIAG_UNAVAILABLE;
+    tPhase = now_nanos();
+    RetCode = SQLExecute(worker->hStmt);
+    PhaseRecord(worker->phases, PHASE_EXECUTE, now_nanos() - tPhase);
+    if (SQL_SUCCESS != RetCode)
+      HandleDiagnosticRecord(worker->hStmt, SQL_HANDLE_STMT, RetCode);
+    CountStatus(worker, n, RetCode);
+    if ((SQL_SUCCESS != RetCode) && (SQL_SUCCESS_WITH_INFO != RetCode))
+      return SQL_ERROR;
+
+    worker->uncommitted += n;
+    if ((config->commitRows > 0) && (worker->uncommitted >= config->commitRows)) {
+      if (SQL_SUCCESS != Commit(worker))
+	return SQL_ERROR;
+    }
+  }
+  return SQL_SUCCESS;
+}
+
+// Claim the next chunk or file; returns -1 when there are none left
+static long long NextWork(OLoadConfig *config)
+{
+  long long limit = config->fromGen ? config->rows.numChunks : config->numFiles;
+  long long next;
+
+  pthread_mutex_lock(&config->lock);
+  next = config->next;
+  if (next < limit)
+    config->next++;
+  pthread_mutex_unlock(&config->lock);
+  return (next < limit) ? next : -1;
+}
+
+/************************************************************************
+/* LoadGenerated: generate and insert chunks until none are left
+/************************************************************************/
+
+static RETCODE LoadGenerated(OLoadWorker *worker)
+{
+  OLoadConfig *config = worker->config;
+  ValueStream  vs;
+  long long    chunk, first, last;
+  long long    tPhase;
+  size_t       rows;
+
+  while ((chunk = NextWork(config)) >= 0) {
+    tPhase = now_nanos();
+    rowgen_chunk(&config->rows, chunk, &first, &last, &vs);
+    rows = rowgen_fields(&config->rows, worker->fields, first, last, &vs);
+    PhaseRecord(worker->phases, PHASE_FORMAT, now_nanos() - tPhase);
+
+    if (SQL_SUCCESS != SendRows(worker, rows))
+      return SQL_ERROR;
+  }
+  return SQL_SUCCESS;
+}
+
+/************************************************************************
+/* LoadFiles: parse and insert CSV files until none are left
+/************************************************************************/
+
+static RETCODE LoadFiles(OLoadWorker *worker)
+{
+  OLoadConfig *config = worker->config;
+  RETCODE      RetCode = SQL_ERROR;
+  CsvIn        in;
+  int64_t      row[NUM_FIELDS];
+  long long    file;
+  long long    tPhase;
+  size_t       rows;
+  int          got;
+  int          f;
+
+  if (0 != csv_in_init(&in, -1, CSV_IN_DEFAULT_SIZE))
+    return SQL_ERROR;
+
+  while ((file = NextWork(config)) >= 0) {
+    const char *path = config->files[file];
+
+    csv_in_reset(&in, (0 == strcmp(path, "-")) ? STDIN_FILENO : open(path, O_RDONLY));
+    if (in.fd < 0) {
+      perror(path);
+      goto Exit;
+    }
+
+    do {
+      tPhase = now_nanos();
+      for (rows = 0; rows < worker->capacity; rows++) {
+	got = csv_in_row(&in, row, NUM_FIELDS);
+	if (got < 0) {
+	  fprintf(stderr, "%s:%lld: expected %d integers\n", path, in.line, NUM_FIELDS);
+	  goto Exit;
+	}
+	if (0 == got)
+	  break;
+	for (f = 0; f < NUM_FIELDS; f++)
+	  worker->fields[f][rows] = row[f];
+      }
+      PhaseRecord(worker->phases, PHASE_FORMAT, now_nanos() - tPhase);
+
+      if (SQL_SUCCESS != SendRows(worker, rows))
+	goto Exit;
+    } while (rows == worker->capacity);
+
+    if (STDIN_FILENO != in.fd)
+      close(in.fd);
+    in.fd = -1;
+  }
+  RetCode = SQL_SUCCESS;
+
+ Exit:
+  if ((in.fd >= 0) && (STDIN_FILENO != in.fd))
+    close(in.fd);
+  csv_in_free(&in);
+  return RetCode;
+}
+
+/************************************************************************
+/* RunWorker: connect, prepare the INSERT, and load until the chunks or
+/*            files run out
+/*
+/* Every worker waits on the start barrier exactly once, even when it
+/* fails to connect, so the other workers are never left hanging.
+/************************************************************************/
+
+static void *RunWorker(void *arg)
+{
+  OLoadWorker *worker = (OLoadWorker *)arg;
+  OLoadConfig *config = worker->config;
+  bool         started = false;
+  long long    tPhase;
+  long long    t0;
+
+  worker->status = -1;
+
+  TRYODBC(config->hEnv,
+	  SQL_HANDLE_ENV,
+	  SQLAllocHandle(SQL_HANDLE_DBC, config->hEnv, &worker->hDbc));
+  tPhase = now_nanos();
+  TRYODBC(worker->hDbc,
+	  SQL_HANDLE_DBC,
+	  SQLDriverConnect(worker->hDbc,
+			   NULL,
+			   (SQLCHAR *)config->pConnStr,
+			   SQL_NTS,
+			   NULL,
+			   0,
+			   NULL,
+			   SQL_DRIVER_COMPLETE));
+  PhaseRecord(worker->phases, PHASE_CONNECT, now_nanos() - tPhase);
+  fprintf(stderr, "Connected!\n");
+
+  if (config->commitRows > 0) {
+    TRYODBC(worker->hDbc,
+	    SQL_HANDLE_DBC,
+	    SQLSetConnectAttr(worker->hDbc, SQL_ATTR_AUTOCOMMIT,
+			      (SQLPOINTER)SQL_AUTOCOMMIT_OFF, 0));
+  }
+
+  TRYODBC(worker->hDbc,
+	  SQL_HANDLE_DBC,
+	  SQLAllocHandle(SQL_HANDLE_STMT, worker->hDbc, &worker->hStmt));
+  tPhase = now_nanos();
+  TRYODBC(worker->hStmt,
+	  SQL_HANDLE_STMT,
+	  SQLPrepare(worker->hStmt, (SQLCHAR *)config->insert, SQL_NTS));
+  PhaseRecord(worker->phases, PHASE_PREPARE, now_nanos() - tPhase);
+
+  // Column-wise parameter arrays, with per-row status
+  TRYODBC(worker->hStmt,
+	  SQL_HANDLE_STMT,
+	  SQLSetStmtAttr(worker->hStmt, SQL_ATTR_PARAM_BIND_TYPE,
+			 (SQLPOINTER)SQL_PARAM_BIND_BY_COLUMN, 0));
+  TRYODBC(worker->hStmt,
+	  SQL_HANDLE_STMT,
+	  SQLSetStmtAttr(worker->hStmt, SQL_ATTR_PARAM_STATUS_PTR, worker->paramStatus, 0));
+  TRYODBC(worker->hStmt,
+	  SQL_HANDLE_STMT,
+	  SQLSetStmtAttr(worker->hStmt, SQL_ATTR_PARAMS_PROCESSED_PTR, &worker->processed, 0));
+
+  pthread_barrier_wait(&config->start);
+  started = true;
+  t0 = now_nanos();
+
+  if (config->fromGen) {
+    if (SQL_SUCCESS != LoadGenerated(worker))
+      goto Exit;
+  }
+  else {
+    if (SQL_SUCCESS != LoadFiles(worker))
+      goto Exit;
+  }
+  if ((config->commitRows > 0) && (worker->uncommitted > 0)) {
+    if (SQL_SUCCESS != Commit(worker))
+      goto Exit;
+  }
+
+  worker->elapsed = (double)(now_nanos() - t0) / NANOS_PER_SEC;
+  worker->status = 0;
+
+ Exit:
+  if (!started)
+    pthread_barrier_wait(&config->start);
+
+  if (worker->hStmt)
+    SQLFreeHandle(SQL_HANDLE_STMT, worker->hStmt);
+  if (worker->hDbc)
+    {
+      if ((0 != worker->status) && (config->commitRows > 0)) {
+	SQLEndTran(SQL_HANDLE_DBC, worker->hDbc, SQL_ROLLBACK);
+	worker->rolledBack += worker->pending;
+	worker->pending = 0;
+      }
+      SQLDisconnect(worker->hDbc);
+      SQLFreeHandle(SQL_HANDLE_DBC, worker->hDbc);
+    }
+  return NULL;
+}
+
+/************************************************************************
+/* oload: load otest.test10 over N connections with array inserts
+/************************************************************************/
+
+int main(int argc, char **argv)
+{
+  OLoadConfig  config = { 0 };
+  OLoadWorker *workers = NULL;
+  char        *table = DEFAULT_TABLE;
+  char        *dist = NULL;
+  char        *rng = NULL;
+  char        *endptr;
+  size_t       len;
+  int          opt;
+  int          f;
+  int          t;
+  int          ret = 1;
+
+  config.batchSize = DEFAULT_BATCH_SIZE;
+  config.numThreads = DEFAULT_LOAD_THREADS;
+
+  while (-1 != (opt = getopt_long(argc, argv, "t:b:c:T:gd:r:", long_options, NULL))) {
+    switch (opt) {
+    case 't':
+      config.numThreads = atoi(optarg);
+      if (config.numThreads < 1) {
+	Usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'b':
+      config.batchSize = strtoull(optarg, &endptr, 10);
+      if ((*endptr != '\0') || (config.batchSize < 1)) {
+	Usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'c':
+      config.commitRows = strtoll(optarg, &endptr, 10);
+      if ((*endptr != '\0') || (config.commitRows < 0)) {
+	Usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'T':
+      table = optarg;
+      break;
+    case 'g':
+      config.fromGen = true;
+      break;
+    case 'd':
+      dist = optarg;
+      break;
+    case 'r':
+      rng = optarg;
+      break;
+    default:
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (config.fromGen ? (argc - optind != 5) : (argc - optind < 2)) {
+    Usage(argv[0]);
+    return 1;
+  }
+  config.pConnStr = argv[optind];
+  if (config.fromGen) {
+    long long numkeys = strtoll(argv[optind + 1], &endptr, 10);
+    long long rowsperkey = strtoll(argv[optind + 2], &endptr, 10);
+    long long offset = strtoll(argv[optind + 3], &endptr, 10) * numkeys;
+    int seed = atoi(argv[optind + 4]);
+    if ((0 != rowgen_init(&config.rows, numkeys, rowsperkey, offset, seed, dist)) ||
+	(0 != rowgen_set_rng(&config.rows, rng))) {
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+  else {
+    config.files = argv + optind + 1;
+    config.numFiles = argc - optind - 1;
+  }
+
+  len = snprintf(config.insert, sizeof(config.insert), "INSERT INTO %s (", table);
+  for (f = 0; f < NUM_FIELDS; f++)
+    len += snprintf(config.insert + len, sizeof(config.insert) - len, "%s%s",
+		    (f > 0) ? ", " : "", fieldNames[f]);
+  len += snprintf(config.insert + len, sizeof(config.insert) - len, ") VALUES (");
+  for (f = 0; f < NUM_FIELDS; f++)
+    len += snprintf(config.insert + len, sizeof(config.insert) - len, "%s?",
+		    (f > 0) ? ", " : "");
+  len += snprintf(config.insert + len, sizeof(config.insert) - len, ")");
+  if (len >= sizeof(config.insert)) {
+    fprintf(stderr, "Table name too long\n");
+    return 1;
+  }
+
+  // Allocate an environment
+  if (SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &config.hEnv) == SQL_ERROR)
+    {
+      fprintf(stderr, "Unable to allocate an environment handle\n");
+      exit(-1);
+    }
+
+  // Register this as an application that expects 3.x behavior,
+  // you must register something if you use AllocHandle
+  TRYODBC(config.hEnv,
+	  SQL_HANDLE_ENV,
+	  SQLSetEnvAttr(config.hEnv,
+			SQL_ATTR_ODBC_VERSION,
+			(SQLPOINTER)SQL_OV_ODBC3,
+			0));
+
+  workers = calloc(config.numThreads, sizeof(OLoadWorker));
+  if (NULL == workers) {
+    fprintf(stderr, "Unable to allocate %d workers\n", config.numThreads);
+    goto Exit;
+  }
+  pthread_mutex_init(&config.lock, NULL);
+  pthread_barrier_init(&config.start, NULL, config.numThreads + 1);
+
+  for (t = 0; t < config.numThreads; t++) {
+    OLoadWorker *worker = &workers[t];
+
+    worker->config = &config;
+    worker->id = t;
+    worker->phases = PhaseTimesNew();
+    // A generated chunk is sent whole; CSV is read a batch at a time
+    worker->capacity = config.batchSize;
+    if (config.fromGen)
+      worker->capacity = config.rows.chunkKeys * config.rows.rowsperkey;
+    worker->paramStatus = calloc(config.batchSize, sizeof(SQLUSMALLINT));
+    if ((NULL == worker->phases) || (NULL == worker->paramStatus))
+      exit(-1);
+    for (f = 0; f < NUM_FIELDS; f++) {
+      worker->fields[f] = malloc((worker->capacity + 1) * sizeof(int64_t));
+      if (NULL == worker->fields[f]) {
+	fprintf(stderr, "Unable to allocate %zu row arrays\n", worker->capacity);
+	exit(-1);
+      }
+    }
+    if (0 != pthread_create(&worker->thread, NULL, RunWorker, worker)) {
+      fprintf(stderr, "Unable to start worker %d\n", t);
+      exit(-1);
+    }
+  }
+
+  pthread_barrier_wait(&config.start);
+  long long t0 = now_nanos();
+
+  for (t = 0; t < config.numThreads; t++) {
+    pthread_join(workers[t].thread, NULL);
+  }
+  double elapsed = (double)(now_nanos() - t0) / NANOS_PER_SEC;
+  pthread_barrier_destroy(&config.start);
+
+  // Report throughput
+  long long loaded = 0;
+  long long failed = 0;
+  long long unused = 0;
+  long long unknown = 0;
+  long long rolledBack = 0;
+  PhaseTimes *phases = PhaseTimesNew();
+  if (NULL == phases) {
+    fprintf(stderr, "Unable to allocate histograms\n");
+    goto Exit;
+  }
+  ret = 0;
+  for (t = 0; t < config.numThreads; t++) {
+    loaded += workers[t].loaded;
+    failed += workers[t].failed;
+    unused += workers[t].unused;
+    unknown += workers[t].unknown;
+    rolledBack += workers[t].rolledBack;
+    PhaseTimesMerge(phases, workers[t].phases);
+    if (0 != workers[t].status)
+      ret = 1;
+    fprintf(stderr, "thread %d: %lld rows in %.3f s, %.1f rows/s\n",
+	    t, workers[t].loaded, workers[t].elapsed,
+	    (workers[t].elapsed > 0) ? workers[t].loaded / workers[t].elapsed : 0.0);
+  }
+  fprintf(stderr, "total: %lld rows in %.3f s, %.1f rows/s across %d connections\n",
+	  loaded, elapsed, (elapsed > 0) ? loaded / elapsed : 0.0, config.numThreads);
+  if (failed > 0) {
+    fprintf(stderr, "failed: %lld rows\n", failed);
+    ret = 1;
+  }
+  if (unused > 0) {
+    fprintf(stderr, "unused: %lld rows not processed by the driver\n", unused);
+    ret = 1;
+  }
+  if (unknown > 0) {
+    fprintf(stderr, "unknown: %lld rows with no status from the driver\n", unknown);
+    ret = 1;
+  }
+  if (rolledBack > 0) {
+    fprintf(stderr, "rolled back: %lld rows inserted but never committed\n", rolledBack);
+    ret = 1;
+  }
+  fprintf(stderr, "batch: %llu rows, commit: ", (unsigned long long)config.batchSize);
+  if (config.commitRows > 0)
+    fprintf(stderr, "every %lld rows\n", config.commitRows);
+  else
+    fprintf(stderr, "autocommit\n");
+  if (config.fromGen) {
+    fprintf(stderr, "rng: ");
+    rowgen_describe_rng(stderr, &config.rows);
+    fprintf(stderr, "\n");
+  }
+  PhaseTimesPrint(stderr, phases);
+  free(phases);
+
+ Exit:
+
+  if (NULL != workers)
+    {
+      for (t = 0; t < config.numThreads; t++) {
+	for (f = 0; f < NUM_FIELDS; f++)
+	  free(workers[t].fields[f]);
+	free(workers[t].paramStatus);
+	free(workers[t].phases);
+      }
+      free(workers);
+    }
+
+  if (config.hEnv)
+    {
+      SQLFreeHandle(SQL_HANDLE_ENV, config.hEnv);
+    }
+
+  return ret;
+}
@@ -0,0 +1,861 @@
+#include <sql.h>
+#include <sqlext.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "odbcutil.h"
+#include "stmtpool.h"
+#include "otest.h"
+#include "timing.h"
+#include "hist.h"
+#include "keydist.h"
+
+/*****************************************/
+/* Settings shared by every worker       */
+/*****************************************/
+typedef struct {
+  SQLHENV      hEnv;
+  char        *pConnStr;
+  const char  *directQuery;
+  const char  *preparedQuery;
+  long long    numkeys;
+  SQLULEN      rowArraySize;
+  bool         prepared;
+  bool         silent;
+  int          poolSize;
+  int          numThreads;
+  double       rate;            // Target total QPS, 0 for closed loop
+  int          async;           // Queries in flight per connection
+  KeyDist      keydist;         // Copied into every worker
+
+  pthread_barrier_t start;      // Workers connect, then start together
+  atomic_llong numQueries;      // Aggregate across all workers
+} OTestConfig;
+
+/*****************************************/
+/* One closed-loop worker: its own       */
+/* connection, statements and RNG stream */
+/*****************************************/
+typedef struct {
+  OTestConfig *config;
+  int          id;
+  long long    iterations;
+  struct drand48_data lcg;
+  KeyDist      keydist;
+  pthread_t    thread;
+
+  long long    completed;
+  double       elapsed;
+  int          status;
+
+  // Latency from the intended send time, and from the actual send time
+  Histogram    latency;
+  Histogram    service;
+  PhaseTimes  *phases;
+} OTestWorker;
+
+static struct option long_options[] = {
+  {"rowarray",   required_argument, NULL, 'a'},
+  {"prepare",    no_argument,       NULL, 'p'},
+  {"stmtpool",   required_argument, NULL, 's'},
+  {"threads",    required_argument, NULL, 't'},
+  {"iterations", required_argument, NULL, 'n'},
+  {"rate",       required_argument, NULL, 'r'},
+  {"async",      required_argument, NULL, 'A'},
+  {"keydist",    required_argument, NULL, 'k'},
+  {NULL,         0,                 NULL, 0}
+};
+
+static void Usage(const char *prog)
+{
+  fprintf(stderr, "Usage: %s [options] <ConnString> <pkey range> <ccol range> <rand seed>\n", prog);
+  fprintf(stderr, "  --rowarray <rows>      rows per SQLFetch (default %d)\n", DEFAULT_ROW_ARRAY_SIZE);
+  fprintf(stderr, "  --prepare              SQLPrepare once and bind the key\n");
+  fprintf(stderr, "  --stmtpool <handles>   statement handles per connection (default %d)\n", DEFAULT_STMT_POOL_SIZE);
+  fprintf(stderr, "  --threads <n>          concurrent connections (default %d)\n", DEFAULT_THREADS);
+  fprintf(stderr, "  --iterations <n>       total queries across all threads (default %d)\n", DEFAULT_ITERATIONS);
+  fprintf(stderr, "  --rate <qps>           open loop: issue queries on a fixed schedule\n");
+  fprintf(stderr, "  --async <n>            asynchronous queries in flight per connection\n");
+  fprintf(stderr, "  --keydist <dist>       key distribution: %s\n", KEYDIST_SPEC_HELP);
+}
+
+// drand48_r as a KeyDistRandom
+static double NextUniform(void *state)
+{
+  double rval;
+
+  drand48_r((struct drand48_data *)state, &rval);
+  return rval;
+}
+
+/************************************************************************
+/* PrintRowCount: report the rows affected by a statement with no
+/*                result set
+/************************************************************************/
+
+static void PrintRowCount(SQLHSTMT hStmt)
+{
+  SQLLEN cRowCount;
+
+  TRYODBC(hStmt,
+	  SQL_HANDLE_STMT,
+	  SQLRowCount(hStmt,&cRowCount));
+
+  if (cRowCount >= 0)
+    {
+      printf("%d %s returned\n",
+	     (int)cRowCount,
+	     (cRowCount == 1) ? "row" : "rows");
+    }
+
+ Exit:
+  return;
+}
+
+/************************************************************************
+/* FinishQuery: consume the result of an execute that has completed
+/*
+/* Returns the number of rows received, or -1 if the query did not
+/* return a result set.
+/************************************************************************/
+
+static long long FinishQuery(OTestWorker *worker,
+			     SQLHSTMT     hStmt,
+			     RETCODE      RetCode)
+{
+  OTestConfig *config = worker->config;
+  SQLSMALLINT  sNumResults;
+  long long    numReceived = -1;
+
+  switch(RetCode)
+    {
+    case SQL_SUCCESS_WITH_INFO:
+      {
+	HandleDiagnosticRecord(hStmt, SQL_HANDLE_STMT, RetCode);
+	// fall through
+      }
+    case SQL_SUCCESS:
+      {
+	// If this is a row-returning query, display
+	// results
+	TRYODBC(hStmt,
+		SQL_HANDLE_STMT,
+		SQLNumResultCols(hStmt,&sNumResults));
+
+	if (sNumResults > 0)
+	  {
+	    numReceived = DisplayResults(hStmt, sNumResults, config->silent,
+					 config->rowArraySize, worker->phases);
+	  }
+	else
+	  {
+	    PrintRowCount(hStmt);
+	  }
+	break;
+      }
+
+    case SQL_ERROR:
+      {
+	HandleDiagnosticRecord(hStmt, SQL_HANDLE_STMT, RetCode);
+	break;
+      }
+
+    default:
+      fprintf(stderr, "Unexpected return code %hd!\n", RetCode);
+
+    }
+
+ Exit:
+  return numReceived;
+}
+
+/************************************************************************
+/* CompleteQuery: record the latency of a finished query
+/************************************************************************/
+
+static void CompleteQuery(OTestWorker *worker,
+			  long long    intended,
+			  long long    sent,
+			  long long    numReceived)
+{
+  long long done = now_nanos();
+
+  hist_record(&worker->latency, done - intended);
+  hist_record(&worker->service, done - sent);
+
+  if (numReceived >= 0) {
+    long long iteration = atomic_fetch_add_explicit(&worker->config->numQueries, 1,
+						    memory_order_relaxed);
+    fprintf(stdout, "iteration %lld: numReceived = %lld\n", iteration, numReceived);
+  }
+  worker->completed++;
+}
+
+/************************************************************************
+/* NextQuery: pick the next key
+/*
+/* The key goes to *pKey, which is the bound parameter in prepared mode,
+/* and in direct mode the SQL text is formatted into pQuery.
+/************************************************************************/
+
+static void NextQuery(OTestWorker *worker,
+		      SQLBIGINT   *pKey,
+		      char        *pQuery)
+{
+  OTestConfig *config = worker->config;
+
+  *pKey = (SQLBIGINT)keydist_next(&worker->keydist, NextUniform, &worker->lcg);
+  if (!config->prepared) {
+    sprintf(pQuery, config->directQuery, (long long)*pKey);
+    if (!config->silent)
+      fprintf(stderr, "Query: %s\n", pQuery);
+  }
+}
+
+/************************************************************************
+/* ExecuteQuery: run the query set up by NextQuery
+/*
+/* Also used to poll an asynchronous execute, which repeats the original
+/* call until it stops returning SQL_STILL_EXECUTING.
+/************************************************************************/
+
+static RETCODE ExecuteQuery(OTestConfig *config,
+			    SQLHSTMT     hStmt,
+			    char        *pQuery)
+{
+  if (config->prepared)
+    return SQLExecute(hStmt);
+  return SQLExecDirect(hStmt, (SQLCHAR *)pQuery, SQL_NTS);
+}
+
+/************************************************************************
+/* PrepareStatement: SQLPrepare the parameterized query on hStmt and
+/*                   bind *pKey as its parameter
+/************************************************************************/
+
+static RETCODE PrepareStatement(OTestWorker *worker,
+				SQLHSTMT     hStmt,
+				SQLBIGINT   *pKey)
+{
+  long long tPhase = now_nanos();
+
+  TRYODBC(hStmt,
+	  SQL_HANDLE_STMT,
+	  SQLPrepare(hStmt, (SQLCHAR *)worker->config->preparedQuery, SQL_NTS));
+  PhaseRecord(worker->phases, PHASE_PREPARE, now_nanos() - tPhase);
+  TRYODBC(hStmt,
+	  SQL_HANDLE_STMT,
+	  SQLBindParameter(hStmt, 1, SQL_PARAM_INPUT, SQL_C_SBIGINT, SQL_BIGINT,
+			   0, 0, pKey, 0, NULL));
+  return SQL_SUCCESS;
+
+ Exit:
+  return SQL_ERROR;
+}
+
+/*****************************************/
+/* One in-flight asynchronous query.     */
+/* Each step of a query is polled in     */
+/* turn with the other slots: the        */
+/* execute, SQLNumResultCols, one        */
+/* SQLDescribeCol per column, and then   */
+/* one SQLFetch per visit until the      */
+/* result set is drained.                */
+/*****************************************/
+typedef enum {
+  SLOT_IDLE,
+  SLOT_EXECUTING,
+  SLOT_DESCRIBING,
+  SLOT_BINDING,
+  SLOT_FETCHING
+} SlotState;
+
+typedef struct {
+  SQLHSTMT    hStmt;
+  SQLBIGINT   key;
+  char        pQuery[1000];
+  SlotState   state;
+  SQLSMALLINT numCols;
+  ResultSet   rs;
+  long long   intended;
+  long long   sent;
+} AsyncSlot;
+
+/************************************************************************
+/* StepSlot: make one call for a busy slot
+/*
+/* Returns true once the query is finished, with the rows received (-1
+/* if there was no result set) in *numReceived.
+/************************************************************************/
+
+static bool StepSlot(OTestWorker *worker,
+		     AsyncSlot   *slot,
+		     long long   *numReceived)
+{
+  OTestConfig *config = worker->config;
+  RETCODE      RetCode;
+
+  *numReceived = -1;
+  switch (slot->state) {
+  case SLOT_EXECUTING:
+    RetCode = ExecuteQuery(config, slot->hStmt, slot->pQuery);
+    if (SQL_STILL_EXECUTING == RetCode)
+      return false;
+    PhaseRecord(worker->phases, PHASE_EXECUTE, now_nanos() - slot->sent);
+    if (SQL_SUCCESS != RetCode)
+      HandleDiagnosticRecord(slot->hStmt, SQL_HANDLE_STMT, RetCode);
+    if ((SQL_SUCCESS != RetCode) && (SQL_SUCCESS_WITH_INFO != RetCode))
+      return true;
+    slot->state = SLOT_DESCRIBING;
+    return false;
+
+  case SLOT_DESCRIBING:
+    RetCode = SQLNumResultCols(slot->hStmt, &slot->numCols);
+    if (SQL_STILL_EXECUTING == RetCode)
+      return false;
+    if (SQL_SUCCESS != RetCode)
+      HandleDiagnosticRecord(slot->hStmt, SQL_HANDLE_STMT, RetCode);
+    if ((SQL_SUCCESS != RetCode) && (SQL_SUCCESS_WITH_INFO != RetCode))
+      return true;
+    if (slot->numCols <= 0) {
+      PrintRowCount(slot->hStmt);
+      return true;
+    }
+    slot->state = SLOT_BINDING;
+    RetCode = ResultSetOpen(&slot->rs, slot->hStmt, slot->numCols, config->silent,
+			    config->rowArraySize, worker->phases);
+    break;
+
+  case SLOT_BINDING:
+    RetCode = ResultSetBind(&slot->rs);
+    break;
+
+  case SLOT_FETCHING:
+    RetCode = ResultSetFetch(&slot->rs);
+    if ((SQL_SUCCESS == RetCode) || (SQL_STILL_EXECUTING == RetCode))
+      return false;
+    *numReceived = ResultSetClose(&slot->rs);
+    return true;
+
+  default:
+    return true;
+  }
+
+  // Binding the result set
+  if (SQL_STILL_EXECUTING == RetCode)
+    return false;
+  if (SQL_SUCCESS != RetCode) {
+    *numReceived = ResultSetClose(&slot->rs);
+    return true;
+  }
+  slot->state = SLOT_FETCHING;
+  return false;
+}
+
+/************************************************************************
+/* RunAsyncQueries: keep up to config->async queries in flight on hDbc
+/*
+/* Every slot owns a statement with SQL_ATTR_ASYNC_ENABLE set (on the
+/* connection instead, if that is all the driver supports).  Statements
+/* are prepared before async is turned on, so SQLPrepare and
+/* SQLBindParameter never answer SQL_STILL_EXECUTING.  The loop
+/* starts a query on each idle slot and polls busy ones by repeating
+/* their current call until it stops returning SQL_STILL_EXECUTING.
+/* Results are fetched a block per visit, so one slot draining its rows
+/* does not hold up the others.
+/*
+/* Returns 0 on success.
+/************************************************************************/
+
+static int RunAsyncQueries(OTestWorker *worker,
+			   SQLHDBC      hDbc,
+			   StmtPool    *pool,
+			   long long    t0,
+			   double       interval,
+			   double       offset)
+{
+  OTestConfig *config = worker->config;
+  AsyncSlot   *slots = NULL;
+  SQLUINTEGER  asyncMode = SQL_AM_NONE;
+  SQLUSMALLINT maxActive = 0;
+  SlotState    prevState;
+  long long    issued = 0;
+  long long    numReceived;
+  int          status = -1;
+  int          s;
+
+  TRYODBC(hDbc,
+	  SQL_HANDLE_DBC,
+	  SQLGetInfo(hDbc, SQL_ASYNC_MODE, &asyncMode, sizeof(asyncMode), NULL));
+  if (SQL_AM_NONE == asyncMode) {
+    fprintf(stderr, "Driver does not support asynchronous execution\n");
+    goto Exit;
+  }
+  TRYODBC(hDbc,
+	  SQL_HANDLE_DBC,
+	  SQLGetInfo(hDbc, SQL_MAX_CONCURRENT_ACTIVITIES, &maxActive, sizeof(maxActive), NULL));
+  if ((maxActive > 0) && (maxActive < config->async))
+    fprintf(stderr, "Driver allows %d active statements per connection, asked for %d\n",
+	    maxActive, config->async);
+
+  slots = calloc(config->async, sizeof(AsyncSlot));
+  if (NULL == slots) {
+    fprintf(stderr, "Unable to allocate %d async slots\n", config->async);
+    goto Exit;
+  }
+  for (s = 0; s < config->async; s++) {
+    if (SQL_SUCCESS != StmtPoolGet(pool, &slots[s].hStmt))
+      goto Exit;
+    if (config->prepared &&
+	(SQL_SUCCESS != PrepareStatement(worker, slots[s].hStmt, &slots[s].key)))
+      goto Exit;
+  }
+  if (SQL_AM_CONNECTION == asyncMode) {
+    TRYODBC(hDbc,
+	    SQL_HANDLE_DBC,
+	    SQLSetConnectAttr(hDbc, SQL_ATTR_ASYNC_ENABLE, (SQLPOINTER)SQL_ASYNC_ENABLE_ON, 0));
+  }
+  else {
+    for (s = 0; s < config->async; s++) {
+      TRYODBC(slots[s].hStmt,
+	      SQL_HANDLE_STMT,
+	      SQLSetStmtAttr(slots[s].hStmt, SQL_ATTR_ASYNC_ENABLE,
+			     (SQLPOINTER)SQL_ASYNC_ENABLE_ON, 0));
+    }
+  }
+
+  while (worker->completed < worker->iterations) {
+    bool      progress = false;
+    bool      anyBusy = false;
+    long long nextDue = 0;
+
+    for (s = 0; s < config->async; s++) {
+      AsyncSlot *slot = &slots[s];
+
+      if (SLOT_IDLE == slot->state) {
+	if (issued >= worker->iterations)
+	  continue;
+	if (interval > 0) {
+	  slot->intended = t0 + (long long)(offset + issued * interval);
+	  if (now_nanos() < slot->intended) {
+	    nextDue = slot->intended;
+	    continue;
+	  }
+	  slot->sent = now_nanos();
+	}
+	else {
+	  slot->intended = slot->sent = now_nanos();
+	}
+	issued++;
+	NextQuery(worker, &slot->key, slot->pQuery);
+	slot->state = SLOT_EXECUTING;
+      }
+
+      prevState = slot->state;
+      if (!StepSlot(worker, slot, &numReceived)) {
+	anyBusy = true;
+	// A fetch that completed leaves no fetch pending
+	if ((slot->state != prevState) ||
+	    ((SLOT_FETCHING == slot->state) && (0 == slot->rs.fetchStart)))
+	  progress = true;
+	continue;
+      }
+      slot->state = SLOT_IDLE;
+      progress = true;
+
+      TRYODBC(slot->hStmt,
+	      SQL_HANDLE_STMT,
+	      SQLFreeStmt(slot->hStmt, SQL_CLOSE));
+      CompleteQuery(worker, slot->intended, slot->sent, numReceived);
+    }
+
+    if (!progress) {
+      if (!anyBusy && (nextDue > 0))
+	sleep_until_nanos(nextDue);
+      else
+	sched_yield();
+    }
+  }
+  status = 0;
+
+ Exit:
+  if (NULL != slots) {
+    for (s = 0; s < config->async; s++) {
+      if (SLOT_IDLE != slots[s].state)
+	SQLCancel(slots[s].hStmt);
+      if ((SLOT_BINDING == slots[s].state) || (SLOT_FETCHING == slots[s].state))
+	ResultSetClose(&slots[s].rs);
+      if (NULL != slots[s].hStmt)
+	StmtPoolPut(pool, slots[s].hStmt);
+    }
+    free(slots);
+  }
+  return status;
+}
+
+/************************************************************************
+/* RunWorker: connect and run this worker's share of the queries
+/*
+/* Every worker waits on the start barrier exactly once, even when it
+/* fails to connect, so the other workers are never left hanging.
+/*
+/* With a target rate the worker runs open loop: query i is due at a
+/* fixed point on the schedule, and its latency is measured from that
+/* intended send time.  A query that is sent late because the previous
+/* one stalled is charged for the wait, so server stalls show up in the
+/* latency instead of silently lowering the offered load.
+/************************************************************************/
+
+static void *RunWorker(void *arg)
+{
+  OTestWorker *worker = (OTestWorker *)arg;
+  OTestConfig *config = worker->config;
+  bool         silent = config->silent;
+  SQLHDBC      hDbc = NULL;
+  SQLHSTMT     hStmt = NULL;
+  StmtPool     pool = { 0 };
+  bool         started = false;
+  char         pQuery[1000];
+  RETCODE      RetCode;
+  SQLBIGINT    key = 0;
+  long long    t0;
+  long long    i;
+  long long    numReceived;
+  long long    tPhase;
+  double       interval = 0;
+  double       offset = 0;
+
+  worker->status = -1;
+
+  // Allocate a connection
+  if (!silent)
+    fprintf(stderr, "Allocating Handle\n");
+  TRYODBC(config->hEnv,
+	  SQL_HANDLE_ENV,
+	  SQLAllocHandle(SQL_HANDLE_DBC, config->hEnv, &hDbc));
+
+  // Connect to the driver.  Use the connection string if supplied
+  // on the input, otherwise let the driver manager prompt for input.
+  if (!silent)
+    fprintf(stderr, "Connecting to driver\n");
+  tPhase = now_nanos();
+  TRYODBC(hDbc,
+	  SQL_HANDLE_DBC,
+	  SQLDriverConnect(hDbc,
+			   NULL,
+			   (SQLCHAR *)config->pConnStr,
+			   SQL_NTS,
+			   NULL,
+			   0,
+			   NULL,
+			   SQL_DRIVER_COMPLETE));
+  PhaseRecord(worker->phases, PHASE_CONNECT, now_nanos() - tPhase);
+
+  fprintf(stderr, "Connected!\n");
+
+  if (SQL_SUCCESS != StmtPoolInit(&pool, hDbc, config->poolSize))
+    goto Exit;
+  if (config->prepared && (config->async <= 1)) {
+    // One statement, parsed and planned once, with the key as a parameter
+    if (SQL_SUCCESS != StmtPoolGet(&pool, &hStmt))
+      goto Exit;
+    if (SQL_SUCCESS != PrepareStatement(worker, hStmt, &key))
+      goto Exit;
+  }
+
+  // Execute the queries
+  pthread_barrier_wait(&config->start);
+  started = true;
+  t0 = now_nanos();
+  if (config->rate > 0) {
+    // Each worker takes every numThreads'th slot of the overall schedule
+    interval = NANOS_PER_SEC * config->numThreads / config->rate;
+    offset = interval * worker->id / config->numThreads;
+  }
+
+  if (config->async > 1) {
+    if (0 != RunAsyncQueries(worker, hDbc, &pool, t0, interval, offset))
+      goto Exit;
+  }
+
+  for (i = worker->completed; i < worker->iterations; i++) {
+    long long intended;
+    long long sent;
+
+    if (interval > 0) {
+      intended = t0 + (long long)(offset + i * interval);
+      sleep_until_nanos(intended);
+      sent = now_nanos();
+    }
+    else {
+      intended = sent = now_nanos();
+    }
+
+    if (!config->prepared) {
+      if (SQL_SUCCESS != StmtPoolGet(&pool, &hStmt))
+	goto Exit;
+    }
+    NextQuery(worker, &key, pQuery);
+    tPhase = now_nanos();
+    RetCode = ExecuteQuery(config, hStmt, pQuery);
+    PhaseRecord(worker->phases, PHASE_EXECUTE, now_nanos() - tPhase);
+
+    numReceived = FinishQuery(worker, hStmt, RetCode);
+
+    if (config->prepared) {
+      TRYODBC(hStmt,
+	      SQL_HANDLE_STMT,
+	      SQLFreeStmt(hStmt, SQL_CLOSE));
+    }
+    else {
+      RetCode = StmtPoolPut(&pool, hStmt);
+      hStmt = NULL;
+      if (SQL_SUCCESS != RetCode)
+	goto Exit;
+    }
+    CompleteQuery(worker, intended, sent, numReceived);
+  }
+
+  worker->elapsed = (double)(now_nanos() - t0) / NANOS_PER_SEC;
+  worker->status = 0;
+
+ Exit:
+  if (!started)
+    pthread_barrier_wait(&config->start);
+
+  // Statement handles all belong to the pool
+  if (pool.numAllocated > 0)
+    {
+      fprintf(stderr, "Statement handles allocated: %d\n", pool.numAllocated);
+    }
+  StmtPoolFree(&pool);
+
+  if (hDbc)
+    {
+      SQLDisconnect(hDbc);
+      SQLFreeHandle(SQL_HANDLE_DBC, hDbc);
+    }
+
+  return NULL;
+}
+
+/************************************************************************
+/* OTestMain: parse the command line, run the workers and report
+/*
+/* Worker t seeds its drand48_r stream with <rand seed> + t, so a single
+/* thread run issues exactly the same keys as before.
+/************************************************************************/
+
+int OTestMain(int         argc,
+	      char      **argv,
+	      const char *directQuery,
+	      const char *preparedQuery)
+{
+  OTestConfig  config = { 0 };
+  OTestWorker *workers = NULL;
+  long long    iterations = DEFAULT_ITERATIONS;
+  char        *endptr;
+  char        *keydist = NULL;
+  int          opt;
+  int          t;
+  int          ret = 1;
+
+  config.directQuery = directQuery;
+  config.preparedQuery = preparedQuery;
+  config.rowArraySize = DEFAULT_ROW_ARRAY_SIZE;
+  config.poolSize = DEFAULT_STMT_POOL_SIZE;
+  config.silent = true;
+  config.numThreads = DEFAULT_THREADS;
+  config.async = 1;
+
+  while (-1 != (opt = getopt_long(argc, argv, "a:ps:t:n:r:A:k:", long_options, NULL))) {
+    switch (opt) {
+    case 'a':
+      config.rowArraySize = strtoull(optarg, &endptr, 10);
+      if ((*endptr != '\0') || (config.rowArraySize < 1)) {
+	Usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'p':
+      config.prepared = true;
+      break;
+    case 's':
+      config.poolSize = atoi(optarg);
+      if (config.poolSize < 1) {
+	Usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 't':
+      config.numThreads = atoi(optarg);
+      if (config.numThreads < 1) {
+	Usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'n':
+      iterations = strtoll(optarg, &endptr, 10);
+      if ((*endptr != '\0') || (iterations < 0)) {
+	Usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'r':
+      config.rate = strtod(optarg, &endptr);
+      if ((*endptr != '\0') || (config.rate <= 0)) {
+	Usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'A':
+      config.async = atoi(optarg);
+      if (config.async < 1) {
+	Usage(argv[0]);
+	return 1;
+      }
+      break;
+    case 'k':
+      keydist = optarg;
+      break;
+    default:
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (argc - optind != 4) {
+    Usage(argv[0]);
+    return 1;
+  }
+  if (config.poolSize < config.async)
+    config.poolSize = config.async;
+  config.pConnStr = argv[optind];
+  config.numkeys = strtoll(argv[optind + 1], &endptr, 10);
+  long long rowsperkey = strtoll(argv[optind + 2], &endptr, 10);
+  int seed = atoi(argv[optind + 3]);
+  if (0 != keydist_init(&config.keydist, keydist, config.numkeys)) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  // Allocate an environment
+  if (!config.silent)
+    fprintf(stderr, "Allocating Handle Enviroment\n");
+  if (SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &config.hEnv) == SQL_ERROR)
+    {
+      fprintf(stderr, "Unable to allocate an environment handle\n");
+      exit(-1);
+    }
+
+  // Register this as an application that expects 3.x behavior,
+  // you must register something if you use AllocHandle
+  if (!config.silent)
+    fprintf(stderr, "Setting to ODBC3\n");
+  TRYODBC(config.hEnv,
+	  SQL_HANDLE_ENV,
+	  SQLSetEnvAttr(config.hEnv,
+			SQL_ATTR_ODBC_VERSION,
+			(SQLPOINTER)SQL_OV_ODBC3,
+			0));
+
+  workers = calloc(config.numThreads, sizeof(OTestWorker));
+  if (NULL == workers) {
+    fprintf(stderr, "Unable to allocate %d workers\n", config.numThreads);
+    goto Exit;
+  }
+  atomic_init(&config.numQueries, 0);
+  pthread_barrier_init(&config.start, NULL, config.numThreads + 1);
+
+  for (t = 0; t < config.numThreads; t++) {
+    workers[t].config = &config;
+    workers[t].id = t;
+    workers[t].phases = PhaseTimesNew();
+    if (NULL == workers[t].phases)
+      exit(-1);
+    hist_init(&workers[t].latency);
+    hist_init(&workers[t].service);
+    workers[t].iterations = iterations / config.numThreads + ((t < iterations % config.numThreads) ? 1 : 0);
+    srand48_r(seed + t, &workers[t].lcg);
+    // Sequential keys: each thread starts its own stretch of the range
+    workers[t].keydist = config.keydist;
+    workers[t].keydist.next = config.keydist.n / config.numThreads * t;
+    if (0 != pthread_create(&workers[t].thread, NULL, RunWorker, &workers[t])) {
+      fprintf(stderr, "Unable to start worker %d\n", t);
+      exit(-1);
+    }
+  }
+
+  pthread_barrier_wait(&config.start);
+  long long t0 = now_nanos();
+
+  for (t = 0; t < config.numThreads; t++) {
+    pthread_join(workers[t].thread, NULL);
+  }
+  double elapsed = (double)(now_nanos() - t0) / NANOS_PER_SEC;
+  pthread_barrier_destroy(&config.start);
+
+  // Report throughput
+  long long completed = 0;
+  Histogram *latency = malloc(sizeof(Histogram));
+  Histogram *service = malloc(sizeof(Histogram));
+  PhaseTimes *phases = PhaseTimesNew();
+  if ((NULL == latency) || (NULL == service) || (NULL == phases)) {
+    fprintf(stderr, "Unable to allocate histograms\n");
+    goto Exit;
+  }
+  hist_init(latency);
+  hist_init(service);
+  ret = 0;
+  for (t = 0; t < config.numThreads; t++) {
+    completed += workers[t].completed;
+    hist_merge(latency, &workers[t].latency);
+    hist_merge(service, &workers[t].service);
+    PhaseTimesMerge(phases, workers[t].phases);
+    if (0 != workers[t].status)
+      ret = 1;
+    fprintf(stderr, "thread %d: %lld queries in %.3f s, %.1f QPS\n",
+	    t, workers[t].completed, workers[t].elapsed,
+	    (workers[t].elapsed > 0) ? workers[t].completed / workers[t].elapsed : 0.0);
+  }
+  fprintf(stderr, "total: %lld queries in %.3f s, %.1f QPS across %d threads\n",
+	  completed, elapsed, (elapsed > 0) ? completed / elapsed : 0.0, config.numThreads);
+  if (config.rate > 0)
+    fprintf(stderr, "target rate: %.1f QPS (open loop)\n", config.rate);
+  fprintf(stderr, "keys: ");
+  keydist_describe(stderr, &config.keydist);
+  fprintf(stderr, "\n");
+  if (elapsed > 0)
+    fprintf(stderr, "achieved concurrency: %.2f queries in flight (up to %d x %d connections)\n",
+	    service->sum / (elapsed * NANOS_PER_SEC), config.async, config.numThreads);
+  hist_print(stderr, "latency", latency);
+  if (config.rate > 0)
+    hist_print(stderr, "service", service);
+  PhaseTimesPrint(stderr, phases);
+  free(latency);
+  free(service);
+  free(phases);
+
+ Exit:
+
+  // Free ODBC handles and exit
+
+  if (NULL != workers)
+    {
+      for (t = 0; t < config.numThreads; t++)
+	free(workers[t].phases);
+      free(workers);
+    }
+
+  if (config.hEnv)
+    {
+      SQLFreeHandle(SQL_HANDLE_ENV, config.hEnv);
+    }
+
+  return ret;
+
+}
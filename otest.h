@@ -0,0 +1,22 @@
+#ifndef OTEST_H
+#define OTEST_H
+
+/*****************************************/
+/* Shared driver for the otest point     */
+/* query benchmarks (otest.c)            */
+/*                                       */
+/* Each otestN.c only supplies its query */
+/* in two forms: a printf format taking  */
+/* the key as %lld, and the same query   */
+/* with a ? parameter for --prepare.     */
+/*****************************************/
+
+#define DEFAULT_ITERATIONS (100000)
+#define DEFAULT_THREADS (1)
+
+int OTestMain(int         argc,
+	      char      **argv,
+	      const char *directQuery,
+	      const char *preparedQuery);
+
+#endif
@@ -0,0 +1,395 @@
+#include "philox.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PHILOX_X86
+#include <immintrin.h>
+#endif
+
+#define PHILOX_M0 (0xD2511F53U)
+#define PHILOX_M1 (0xCD9E8D57U)
+#define PHILOX_W0 (0x9E3779B9U)
+#define PHILOX_W1 (0xBB67AE85U)
+#define PHILOX_ROUNDS (10)
+
+/************************************************************************
+/* philox4x32: one block of output for one counter
+/************************************************************************/
+
+void philox4x32(PhiloxKey key, const uint32_t ctr[4], uint32_t out[4]) {
+  uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+  uint32_t k0 = key.k[0], k1 = key.k[1];
+  int r;
+
+  for (r = 0; r < PHILOX_ROUNDS; r++) {
+    uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+    uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+
+    c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    c1 = (uint32_t)p1;
+    c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c3 = (uint32_t)p0;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+// A range of 0 keeps the raw word
+static inline int64_t scale(uint32_t word, uint32_t range) {
+  if (0 == range)
+    return word;
+  return (int64_t)(((uint64_t)word * range) >> 32);
+}
+
+/************************************************************************
+/* philox_row: the numCols values of row (pkey, ccol)
+/************************************************************************/
+
+void philox_row(PhiloxKey key, long long pkey, long long ccol, int numCols,
+		uint32_t range, int64_t *vals) {
+  uint32_t ctr[4], out[4];
+  int c;
+
+  ctr[0] = (uint32_t)pkey;
+  ctr[1] = (uint32_t)((uint64_t)pkey >> 32);
+  ctr[2] = (uint32_t)ccol;
+  for (c = 0; c < numCols; c++) {
+    if (0 == (c & 3)) {
+      ctr[3] = c >> 2;
+      philox4x32(key, ctr, out);
+    }
+    vals[c] = scale(out[c & 3], range);
+  }
+}
+
+// Where a block of rows starts: the stream goes in the top bits of the
+// last counter word, and the rows run on from (pkey, ccol)
+typedef struct {
+  uint32_t stream;
+  long long pkey;
+  long long ccol;
+  long long rowsperkey;
+} FillStart;
+
+// Rows [start, rows) one at a time
+static void fill_scalar(PhiloxKey key, const FillStart *at, size_t start,
+			size_t rows, int numCols, uint32_t range, int64_t **cols) {
+  long long skip = at->ccol + (long long)start;
+  long long pkey = at->pkey + skip / at->rowsperkey;
+  uint32_t ccol = (uint32_t)(skip % at->rowsperkey);
+  uint32_t ctr[4], out[4];
+  size_t r;
+  int c;
+
+  for (r = start; r < rows; r++) {
+    ctr[0] = (uint32_t)pkey;
+    ctr[1] = (uint32_t)((uint64_t)pkey >> 32);
+    ctr[2] = ccol;
+    for (c = 0; c < numCols; c++) {
+      if (0 == (c & 3)) {
+	ctr[3] = at->stream | (c >> 2);
+	philox4x32(key, ctr, out);
+      }
+      cols[c][r] = scale(out[c & 3], range);
+    }
+    if (++ccol == at->rowsperkey) {
+      ccol = 0;
+      pkey++;
+    }
+  }
+}
+
+/*****************************************/
+/* SIMD kernels                          */
+/*                                       */
+/* Each lane is one row: the counter     */
+/* words of consecutive rows sit side by */
+/* side, so all the rounds are lane-wise */
+/* and the output word w of the lanes is */
+/* already the run of column values for  */
+/* those rows.  The 32x32->64 multiplies */
+/* are done as even and odd lanes with   */
+/* mul_epu32.  AVX2 does 8 rows per      */
+/* register, SSE2 does 4, and both keep  */
+/* two registers of rows in flight.      */
+/* Other targets use fill_scalar.        */
+/*****************************************/
+
+#if defined(PHILOX_X86)
+__attribute__((target("sse2")))
+static inline void mulhilo_sse2(__m128i a, __m128i m, __m128i *hi, __m128i *lo) {
+  const __m128i low = _mm_set1_epi64x(0xFFFFFFFFLL);
+  __m128i even = _mm_mul_epu32(a, m);
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+
+  *lo = _mm_or_si128(_mm_and_si128(even, low), _mm_slli_epi64(odd, 32));
+  *hi = _mm_or_si128(_mm_srli_epi64(even, 32), _mm_andnot_si128(low, odd));
+}
+
+// (word * range) >> 32 of 4 lanes, or the words themselves for a range
+// of 0, stored as 4 int64s
+__attribute__((target("sse2")))
+static inline void scale_store_sse2(__m128i w, uint32_t range, int64_t *dst) {
+  __m128i even, odd;
+
+  if (0 == range) {
+    even = _mm_and_si128(w, _mm_set1_epi64x(0xFFFFFFFFLL));
+    odd = _mm_srli_epi64(w, 32);
+  }
+  else {
+    __m128i vrange = _mm_set1_epi32((int)range);
+
+    even = _mm_srli_epi64(_mm_mul_epu32(w, vrange), 32);
+    odd = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(w, 32), vrange), 32);
+  }
+  _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi64(even, odd));
+  _mm_storeu_si128((__m128i *)(dst + 2), _mm_unpackhi_epi64(even, odd));
+}
+
+typedef struct {
+  __m128i c[4];
+} Lanes4;
+
+__attribute__((target("sse2")))
+static inline void load_sse2(Lanes4 *x, const uint32_t *lo, const uint32_t *hi,
+			     const uint32_t *cc, uint32_t c3) {
+  x->c[0] = _mm_loadu_si128((const __m128i *)lo);
+  x->c[1] = _mm_loadu_si128((const __m128i *)hi);
+  x->c[2] = _mm_loadu_si128((const __m128i *)cc);
+  x->c[3] = _mm_set1_epi32((int)c3);
+}
+
+__attribute__((target("sse2")))
+static inline void round_sse2(Lanes4 *x, __m128i k0, __m128i k1) {
+  const __m128i m0 = _mm_set1_epi32((int)PHILOX_M0);
+  const __m128i m1 = _mm_set1_epi32((int)PHILOX_M1);
+  __m128i hi0, lo0, hi1, lo1;
+
+  mulhilo_sse2(x->c[0], m0, &hi0, &lo0);
+  mulhilo_sse2(x->c[2], m1, &hi1, &lo1);
+  x->c[0] = _mm_xor_si128(_mm_xor_si128(hi1, x->c[1]), k0);
+  x->c[1] = lo1;
+  x->c[2] = _mm_xor_si128(_mm_xor_si128(hi0, x->c[3]), k1);
+  x->c[3] = lo0;
+}
+
+// Two independent sets of 4 rows per step, so their multiplies overlap
+__attribute__((target("sse2")))
+static void fill_sse2(PhiloxKey key, const FillStart *at, size_t rows, int numCols,
+		      uint32_t range, int64_t **cols) {
+  long long pkey = at->pkey;
+  uint32_t ccol = (uint32_t)at->ccol;
+  uint32_t lo[8], hi[8], cc[8];
+  size_t r;
+  int c, g, i, l;
+
+  for (r = 0; r + 8 <= rows; r += 8) {
+    for (l = 0; l < 8; l++) {
+      lo[l] = (uint32_t)pkey;
+      hi[l] = (uint32_t)((uint64_t)pkey >> 32);
+      cc[l] = ccol;
+      if (++ccol == at->rowsperkey) {
+	ccol = 0;
+	pkey++;
+      }
+    }
+    for (g = 0; 4 * g < numCols; g++) {
+      __m128i k0 = _mm_set1_epi32((int)key.k[0]);
+      __m128i k1 = _mm_set1_epi32((int)key.k[1]);
+      Lanes4 a, b;
+
+      load_sse2(&a, lo, hi, cc, at->stream | g);
+      load_sse2(&b, lo + 4, hi + 4, cc + 4, at->stream | g);
+      for (i = 0; i < PHILOX_ROUNDS; i++) {
+	round_sse2(&a, k0, k1);
+	round_sse2(&b, k0, k1);
+	k0 = _mm_add_epi32(k0, _mm_set1_epi32((int)PHILOX_W0));
+	k1 = _mm_add_epi32(k1, _mm_set1_epi32((int)PHILOX_W1));
+      }
+      for (c = 4 * g; (c < 4 * g + 4) && (c < numCols); c++) {
+	scale_store_sse2(a.c[c & 3], range, cols[c] + r);
+	scale_store_sse2(b.c[c & 3], range, cols[c] + r + 4);
+      }
+    }
+  }
+  fill_scalar(key, at, r, rows, numCols, range, cols);
+}
+
+__attribute__((target("avx2")))
+static inline void mulhilo_avx2(__m256i a, __m256i m, __m256i *hi, __m256i *lo) {
+  __m256i even = _mm256_mul_epu32(a, m);
+  __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+
+  *lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+  *hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+}
+
+// (word * range) >> 32 of 8 lanes, or the words themselves for a range
+// of 0, stored as 8 int64s
+__attribute__((target("avx2")))
+static inline void scale_store_avx2(__m256i w, uint32_t range, int64_t *dst) {
+  __m256i even, odd, lo, hi;
+
+  if (0 == range) {
+    even = _mm256_blend_epi32(w, _mm256_setzero_si256(), 0xAA);
+    odd = _mm256_srli_epi64(w, 32);
+  }
+  else {
+    __m256i vrange = _mm256_set1_epi32((int)range);
+
+    even = _mm256_srli_epi64(_mm256_mul_epu32(w, vrange), 32);
+    odd = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(w, 32), vrange), 32);
+  }
+  lo = _mm256_unpacklo_epi64(even, odd);  // rows 0 1 | 4 5
+  hi = _mm256_unpackhi_epi64(even, odd);  // rows 2 3 | 6 7
+
+  _mm256_storeu_si256((__m256i *)dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+  _mm256_storeu_si256((__m256i *)(dst + 4), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+typedef struct {
+  __m256i c[4];
+} Lanes8;
+
+__attribute__((target("avx2")))
+static inline void load_avx2(Lanes8 *x, const uint32_t *lo, const uint32_t *hi,
+			     const uint32_t *cc, uint32_t c3) {
+  x->c[0] = _mm256_loadu_si256((const __m256i *)lo);
+  x->c[1] = _mm256_loadu_si256((const __m256i *)hi);
+  x->c[2] = _mm256_loadu_si256((const __m256i *)cc);
+  x->c[3] = _mm256_set1_epi32((int)c3);
+}
+
+__attribute__((target("avx2")))
+static inline void round_avx2(Lanes8 *x, __m256i k0, __m256i k1) {
+  const __m256i m0 = _mm256_set1_epi32((int)PHILOX_M0);
+  const __m256i m1 = _mm256_set1_epi32((int)PHILOX_M1);
+  __m256i hi0, lo0, hi1, lo1;
+
+  mulhilo_avx2(x->c[0], m0, &hi0, &lo0);
+  mulhilo_avx2(x->c[2], m1, &hi1, &lo1);
+  x->c[0] = _mm256_xor_si256(_mm256_xor_si256(hi1, x->c[1]), k0);
+  x->c[1] = lo1;
+  x->c[2] = _mm256_xor_si256(_mm256_xor_si256(hi0, x->c[3]), k1);
+  x->c[3] = lo0;
+}
+
+// Two independent sets of 8 rows per step, so their multiplies overlap
+__attribute__((target("avx2")))
+static void fill_avx2(PhiloxKey key, const FillStart *at, size_t rows, int numCols,
+		      uint32_t range, int64_t **cols) {
+  long long pkey = at->pkey;
+  uint32_t ccol = (uint32_t)at->ccol;
+  uint32_t lo[16], hi[16], cc[16];
+  size_t r;
+  int c, g, i, l;
+
+  for (r = 0; r + 16 <= rows; r += 16) {
+    for (l = 0; l < 16; l++) {
+      lo[l] = (uint32_t)pkey;
+      hi[l] = (uint32_t)((uint64_t)pkey >> 32);
+      cc[l] = ccol;
+      if (++ccol == at->rowsperkey) {
+	ccol = 0;
+	pkey++;
+      }
+    }
+    for (g = 0; 4 * g < numCols; g++) {
+      __m256i k0 = _mm256_set1_epi32((int)key.k[0]);
+      __m256i k1 = _mm256_set1_epi32((int)key.k[1]);
+      Lanes8 a, b;
+
+      load_avx2(&a, lo, hi, cc, at->stream | g);
+      load_avx2(&b, lo + 8, hi + 8, cc + 8, at->stream | g);
+      for (i = 0; i < PHILOX_ROUNDS; i++) {
+	round_avx2(&a, k0, k1);
+	round_avx2(&b, k0, k1);
+	k0 = _mm256_add_epi32(k0, _mm256_set1_epi32((int)PHILOX_W0));
+	k1 = _mm256_add_epi32(k1, _mm256_set1_epi32((int)PHILOX_W1));
+      }
+      for (c = 4 * g; (c < 4 * g + 4) && (c < numCols); c++) {
+	scale_store_avx2(a.c[c & 3], range, cols[c] + r);
+	scale_store_avx2(b.c[c & 3], range, cols[c] + r + 8);
+      }
+    }
+  }
+  // Leave no dirty upper halves behind for SSE code (libm, say) to
+  // stall on; gcc does not always do this for target("avx2") functions
+  _mm256_zeroupper();
+  fill_scalar(key, at, r, rows, numCols, range, cols);
+}
+
+// Widest kernel the CPU supports: 2 for AVX2, 1 for SSE2, 0 for neither
+static int simd_level(void) {
+  static int cached = -1;
+
+  if (cached < 0) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      cached = 2;
+    else if (__builtin_cpu_supports("sse2"))
+      cached = 1;
+    else
+      cached = 0;
+  }
+  return cached;
+}
+#endif
+
+/************************************************************************
+/* philox_fill_block: fill cols[0..numCols) for rows consecutive rows
+/*                    starting at (pkey, ccol), rowsperkey rows per key,
+/*                    with the widest kernel the CPU supports
+/*
+/* Column c of a row comes from the counter with last word
+/* stream | c / 4.  A range of 0 stores the raw 32-bit words instead of
+/* scaled values.
+/************************************************************************/
+
+void philox_fill_block(PhiloxKey key, uint32_t stream, long long pkey, long long ccol,
+		       long long rowsperkey, size_t rows, int numCols, uint32_t range,
+		       int64_t **cols) {
+  FillStart at;
+
+  if (rowsperkey <= 0)
+    return;
+  at.stream = stream;
+  at.pkey = pkey + ccol / rowsperkey;
+  at.ccol = ccol % rowsperkey;
+  at.rowsperkey = rowsperkey;
+#if defined(PHILOX_X86)
+  switch (simd_level()) {
+  case 2:
+    fill_avx2(key, &at, rows, numCols, range, cols);
+    return;
+  case 1:
+    fill_sse2(key, &at, rows, numCols, range, cols);
+    return;
+  }
+#endif
+  fill_scalar(key, &at, 0, rows, numCols, range, cols);
+}
+
+/************************************************************************
+/* philox_fill_rows: fill cols[0..numCols) for rows consecutive rows
+/*                   starting at (firstKey, ccol 0), rowsperkey rows per
+/*                   key
+/************************************************************************/
+
+void philox_fill_rows(PhiloxKey key, long long firstKey, long long rowsperkey,
+		      size_t rows, int numCols, uint32_t range, int64_t **cols) {
+  philox_fill_block(key, 0, firstKey, 0, rowsperkey, rows, numCols, range, cols);
+}
+
+const char *philox_impl(void) {
+#if defined(PHILOX_X86)
+  static const char *const names[] = { "scalar", "sse2", "avx2" };
+
+  return names[simd_level()];
+#else
+  return "scalar";
+#endif
+}
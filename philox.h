@@ -0,0 +1,43 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*****************************************/
+/* Philox4x32-10 counter-based generator */
+/*                                       */
+/* Salmon et al., "Parallel random       */
+/* numbers: as easy as 1, 2, 3" (SC11).  */
+/* Ten rounds of multiply and xor map a  */
+/* 128-bit counter and a 64-bit key to   */
+/* 128 random bits.  There is no state:  */
+/* any output is computed directly from  */
+/* its counter, and independent counters */
+/* run side by side in SIMD lanes.       */
+/*                                       */
+/* For rows of the dataset the key is    */
+/* the seed, and column c of row         */
+/* (pkey, ccol) is word c % 4 of the     */
+/* output for counter                    */
+/*   (pkey low, pkey high, ccol, c / 4)  */
+/* scaled to [0, range) as               */
+/* (word * range) >> 32.                 */
+/*****************************************/
+
+typedef struct {
+  uint32_t k[2];
+} PhiloxKey;
+
+void philox4x32(PhiloxKey key, const uint32_t ctr[4], uint32_t out[4]);
+void philox_row(PhiloxKey key, long long pkey, long long ccol, int numCols,
+		uint32_t range, int64_t *vals);
+
+void philox_fill_rows(PhiloxKey key, long long firstKey, long long rowsperkey,
+		      size_t rows, int numCols, uint32_t range, int64_t **cols);
+void philox_fill_block(PhiloxKey key, uint32_t stream, long long pkey, long long ccol,
+		       long long rowsperkey, size_t rows, int numCols, uint32_t range,
+		       int64_t **cols);
+const char *philox_impl(void);
+
+#endif
@@ -0,0 +1,295 @@
+#include <string.h>
+
+#include "rowgen.h"
+
+const char *const fieldNames[NUM_FIELDS] = {
+  "pkey", "ccol", "col1", "col2", "col3", "col4", "col5", "col6", "col7", "col8"
+};
+
+// Same state as srand48_r(seed)
+void lcg_seed(Lcg *lcg, long seed) {
+  lcg->x = (((uint64_t)seed & 0xffffffffULL) << 16) | 0x330E;
+}
+
+/************************************************************************
+/* lcg_jump: advance n steps at once
+/*
+/* Composes the step x -> a*x + c with itself by repeated squaring.
+/************************************************************************/
+
+void lcg_jump(Lcg *lcg, uint64_t n) {
+  uint64_t a = LCG_A, c = LCG_C;
+  uint64_t accA = 1, accC = 0;
+
+  while (n > 0) {
+    if (n & 1) {
+      accA = (accA * a) & LCG_MASK;
+      accC = (accC * a + c) & LCG_MASK;
+    }
+    c = ((a + 1) * c) & LCG_MASK;
+    a = (a * a) & LCG_MASK;
+    n >>= 1;
+  }
+  lcg->x = (accA * lcg->x + accC) & LCG_MASK;
+}
+
+double lcg_uniform(void *state) {
+  return lcg_next((Lcg *)state);
+}
+
+/*****************************************/
+/* Philox draws for other distributions  */
+/*                                       */
+/* The values of row (pkey, ccol) take   */
+/* their draws in column order from      */
+/* counters (pkey low, pkey high, ccol,  */
+/* PHILOX_DRAW | i) for i = 0, 1, ...,   */
+/* one draw of 32 bits per word, which   */
+/* is plenty to pick among COL_RANGE     */
+/* values.  The top bit keeps them apart */
+/* from the uniform values' counters.    */
+/*                                       */
+/* rowgen_fields fills the first words   */
+/* of a block of rows at once with       */
+/* philox_fill_block, DRAW_BLOCK rows at */
+/* a time; a row that needs more draws   */
+/* goes on one counter at a time, so the */
+/* values are the same either way.       */
+/*****************************************/
+
+#define PHILOX_DRAW (0x80000000U)
+#define DRAW_BLOCK (256)
+#define MAX_DRAW_WORDS (2 * NUM_COLS)
+
+typedef struct {
+  PhiloxKey key;
+  uint32_t ctr[4];
+  uint32_t out[4];
+  int used;
+  int64_t **words;             // Filled words of this row, or NULL
+  size_t row;
+  int numWords;
+  int next;
+} PhiloxDraws;
+
+// Words to fill per row: the two draws per value of hotspot, one per
+// value for zipf (which only sometimes needs more), none for sequential
+static int draw_words(const KeyDist *dist) {
+  switch (dist->type) {
+  case KEYDIST_HOTSPOT:
+    return 2 * NUM_COLS;
+  case KEYDIST_ZIPF:
+    return NUM_COLS;
+  default:
+    return 0;
+  }
+}
+
+static double philox_uniform(void *state) {
+  PhiloxDraws *d = (PhiloxDraws *)state;
+
+  if (d->next < d->numWords)
+    return (double)d->words[d->next++][d->row] / (double)(1ULL << 32);
+  if (d->used >= 4) {
+    philox4x32(d->key, d->ctr, d->out);
+    d->ctr[3]++;
+    d->used = 0;
+  }
+  return (double)d->out[d->used++] / (double)(1ULL << 32);
+}
+
+// The values of row (pkey, ccol); words holds its first numWords draw
+// words at index row, if numWords > 0
+static void philox_values(PhiloxKey key, KeyDist *dist, long long pkey,
+			  long long ccol, int64_t **words, size_t row,
+			  int numWords, int64_t *vals) {
+  PhiloxDraws d;
+  int k;
+
+  d.key = key;
+  d.ctr[0] = (uint32_t)pkey;
+  d.ctr[1] = (uint32_t)((uint64_t)pkey >> 32);
+  d.ctr[2] = (uint32_t)ccol;
+  d.ctr[3] = PHILOX_DRAW | (numWords / 4);
+  d.used = 4;
+  d.words = words;
+  d.row = row;
+  d.numWords = numWords;
+  d.next = 0;
+  for (k = 0; k < NUM_COLS; k++)
+    vals[k] = keydist_next(dist, philox_uniform, &d);
+}
+
+/************************************************************************
+/* rowgen_init: set up keys [offset, offset + numkeys) seeded as gen
+/*              <seed> would be, with column values from the dist spec
+/*
+/* Returns -1 if the spec is not understood.
+/************************************************************************/
+
+int rowgen_init(RowGen *rg, long long numkeys, long long rowsperkey,
+		long long offset, long seed, const char *dist) {
+  rg->offset = offset;
+  rg->numkeys = (numkeys > 0) ? numkeys : 0;
+  rg->rowsperkey = (rowsperkey > 0) ? rowsperkey : 0;
+  rg->chunkKeys = (rg->rowsperkey > 0) ? CHUNK_ROWS / rg->rowsperkey : CHUNK_ROWS;
+  if (rg->chunkKeys < 1)
+    rg->chunkKeys = 1;
+  rg->numChunks = (rg->numkeys + rg->chunkKeys - 1) / rg->chunkKeys;
+  rg->rng = ROWGEN_LCG;
+  lcg_seed(&rg->start, seed);
+  rg->key.k[0] = (uint32_t)seed;
+  rg->key.k[1] = (uint32_t)((uint64_t)seed >> 32);
+  return keydist_init(&rg->dist, dist, COL_RANGE);
+}
+
+/************************************************************************
+/* rowgen_set_rng: choose the generator by name (NULL for the default)
+/*
+/* Returns -1 if the name is not understood.
+/************************************************************************/
+
+int rowgen_set_rng(RowGen *rg, const char *rng) {
+  if ((NULL == rng) || (0 == strcmp(rng, "lcg")))
+    rg->rng = ROWGEN_LCG;
+  else if (0 == strcmp(rng, "philox"))
+    rg->rng = ROWGEN_PHILOX;
+  else
+    return -1;
+  return 0;
+}
+
+// Name the generator, and for philox the kernel it dispatched to
+void rowgen_describe_rng(FILE *f, const RowGen *rg) {
+  if (ROWGEN_PHILOX == rg->rng)
+    fprintf(f, "philox (%s)", philox_impl());
+  else
+    fprintf(f, "lcg");
+}
+
+/************************************************************************
+/* rowgen_chunk: find the keys [*first, *last) of a chunk and position
+/*               vs at its first value
+/************************************************************************/
+
+void rowgen_chunk(const RowGen *rg, long long chunk, long long *first,
+		  long long *last, ValueStream *vs) {
+  *first = rg->offset + chunk * rg->chunkKeys;
+  *last = *first + rg->chunkKeys;
+  if (*last > rg->offset + rg->numkeys)
+    *last = rg->offset + rg->numkeys;
+
+  vs->lcg = rg->start;
+  vs->dist = rg->dist;
+  if (KEYDIST_UNIFORM == rg->dist.type) {
+    if (ROWGEN_LCG == rg->rng)
+      lcg_jump(&vs->lcg, (uint64_t)(*first - rg->offset) * rg->rowsperkey * NUM_COLS);
+  }
+  else {
+    if (ROWGEN_LCG == rg->rng)
+      lcg_jump(&vs->lcg, (uint64_t)chunk << CHUNK_STREAM_BITS);
+    vs->dist.next = (*first - rg->offset) * rg->rowsperkey * NUM_COLS % rg->dist.n;
+  }
+}
+
+/************************************************************************
+/* rowgen_fields: generate keys [first, last) into one array per field
+/*
+/* Returns the number of rows.
+/************************************************************************/
+
+size_t rowgen_fields(const RowGen *rg, int64_t **fields, long long first,
+		     long long last, ValueStream *vs) {
+  long long i, j, k;
+  size_t row = 0;
+
+  if (ROWGEN_PHILOX != rg->rng) {
+    for (i = first; i < last; i++) {
+      for (j = 0; j < rg->rowsperkey; j++) {
+	fields[0][row] = i;
+	fields[1][row] = j;
+	for (k = 0; k < NUM_COLS; k++)
+	  fields[k + 2][row] = value_next(vs);
+	row++;
+      }
+    }
+    return row;
+  }
+
+  for (i = first; i < last; i++) {
+    for (j = 0; j < rg->rowsperkey; j++) {
+      fields[0][row] = i;
+      fields[1][row] = j;
+      row++;
+    }
+  }
+  if (KEYDIST_UNIFORM == vs->dist.type) {
+    philox_fill_rows(rg->key, first, rg->rowsperkey, row, NUM_COLS, COL_RANGE, fields + 2);
+  }
+  else {
+    int64_t buf[MAX_DRAW_WORDS][DRAW_BLOCK];
+    int64_t *words[MAX_DRAW_WORDS];
+    int numWords = draw_words(&vs->dist);
+    size_t r, b, n;
+
+    for (k = 0; k < numWords; k++)
+      words[k] = buf[k];
+    for (r = 0; r < row; r += n) {
+      n = (row - r < DRAW_BLOCK) ? row - r : DRAW_BLOCK;
+      if (numWords > 0)
+	philox_fill_block(rg->key, PHILOX_DRAW, fields[0][r], fields[1][r], rg->rowsperkey,
+			  n, numWords, 0, words);
+      for (b = 0; b < n; b++) {
+	int64_t vals[NUM_COLS];
+
+	philox_values(rg->key, &vs->dist, fields[0][r + b], fields[1][r + b], words, b,
+		      numWords, vals);
+	for (k = 0; k < NUM_COLS; k++)
+	  fields[k + 2][r + b] = vals[k];
+      }
+    }
+  }
+  return row;
+}
+
+/************************************************************************
+/* rowgen_row: the NUM_COLS values of row (pkey, ccol) on their own, the
+/*             same as rowgen_fields gives for that row
+/*
+/* With philox, or uniform LCG values, this costs about one row.
+/* Otherwise the row's chunk is replayed up to the row.  Returns -1 if
+/* the row is not one of rg's.
+/************************************************************************/
+
+int rowgen_row(const RowGen *rg, long long pkey, long long ccol, int64_t *vals) {
+  long long first, last, n;
+  ValueStream vs;
+  int k;
+
+  if ((pkey < rg->offset) || (pkey >= rg->offset + rg->numkeys) ||
+      (ccol < 0) || (ccol >= rg->rowsperkey))
+    return -1;
+  rowgen_chunk(rg, (pkey - rg->offset) / rg->chunkKeys, &first, &last, &vs);
+  // Values in the chunk before this row
+  n = ((pkey - first) * rg->rowsperkey + ccol) * NUM_COLS;
+
+  if (ROWGEN_PHILOX == rg->rng) {
+    if (KEYDIST_UNIFORM == rg->dist.type) {
+      philox_row(rg->key, pkey, ccol, NUM_COLS, COL_RANGE, vals);
+    }
+    else {
+      vs.dist.next = (vs.dist.next + n) % rg->dist.n;
+      philox_values(rg->key, &vs.dist, pkey, ccol, NULL, 0, 0, vals);
+    }
+    return 0;
+  }
+
+  if (KEYDIST_UNIFORM == rg->dist.type)
+    lcg_jump(&vs.lcg, (uint64_t)n);
+  else
+    while (n-- > 0)
+      value_next(&vs);
+  for (k = 0; k < NUM_COLS; k++)
+    vals[k] = value_next(&vs);
+  return 0;
+}
@@ -0,0 +1,131 @@
+#ifndef ROWGEN_H
+#define ROWGEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "keydist.h"
+#include "philox.h"
+
+/*****************************************/
+/* Rows of the otest.test10 dataset      */
+/*                                       */
+/* Each key has rowsperkey rows with     */
+/* ccol 0, 1, ... and NUM_COLS values    */
+/* drawn over [0, COL_RANGE).  Keys are  */
+/* cut into chunks of about CHUNK_ROWS   */
+/* rows, and any chunk can be generated  */
+/* on its own, so threads can share the  */
+/* work and still produce the same rows  */
+/* as one thread.                        */
+/*****************************************/
+
+#define NUM_COLS (8)
+#define COL_RANGE (1000000)
+// pkey, ccol, col1..colN
+#define NUM_FIELDS (NUM_COLS + 2)
+
+// Column names of the fields, in order
+extern const char *const fieldNames[NUM_FIELDS];
+
+#define CHUNK_ROWS (1 << 16)
+
+/*****************************************/
+/* drand48-compatible generator          */
+/*                                       */
+/* The same 48-bit LCG as drand48_r, so  */
+/* for a given seed the values match the */
+/* original single-threaded gen.  Unlike */
+/* drand48_r it can jump ahead n steps   */
+/* in O(log n), which lets every chunk   */
+/* of keys start at its own place in the */
+/* one sequence.                         */
+/*****************************************/
+
+#define LCG_A (0x5DEECE66DULL)
+#define LCG_C (0xBULL)
+#define LCG_MASK ((1ULL << 48) - 1)
+
+typedef struct {
+  uint64_t x;
+} Lcg;
+
+void lcg_seed(Lcg *lcg, long seed);
+void lcg_jump(Lcg *lcg, uint64_t n);
+
+// Same value as drand48_r: advance, then x / 2^48
+static inline double lcg_next(Lcg *lcg) {
+  lcg->x = (LCG_A * lcg->x + LCG_C) & LCG_MASK;
+  return (double)lcg->x / (double)(1ULL << 48);
+}
+
+// lcg_next as a KeyDistRandom
+double lcg_uniform(void *state);
+
+/*****************************************/
+/* Column values                         */
+/*                                       */
+/* Uniform values use one LCG step each, */
+/* as the original gen did.  Other       */
+/* distributions take a varying number   */
+/* of steps per value, so each chunk     */
+/* instead gets its own stretch of the   */
+/* sequence, 2^28 steps apart.           */
+/*                                       */
+/* With ROWGEN_PHILOX every value is     */
+/* Philox4x32-10 of its own (pkey, ccol, */
+/* column) instead, keyed by the seed    */
+/* (see philox.h).  Nothing depends on   */
+/* the values before it, so whole blocks */
+/* of rows come out of the SIMD kernels  */
+/* and rowgen_row can rebuild any row on */
+/* its own.  Other distributions draw    */
+/* from the same generator, with its own */
+/* run of counters per row.  The LCG     */
+/* stays the default so that existing    */
+/* datasets can still be regenerated.    */
+/*****************************************/
+
+#define CHUNK_STREAM_BITS (28)
+
+typedef struct {
+  Lcg lcg;
+  KeyDist dist;
+} ValueStream;
+
+static inline int64_t value_next(ValueStream *vs) {
+  if (KEYDIST_UNIFORM == vs->dist.type)
+    return (int64_t)(lcg_next(&vs->lcg) * COL_RANGE);
+  return keydist_next(&vs->dist, lcg_uniform, &vs->lcg);
+}
+
+typedef enum {
+  ROWGEN_LCG,
+  ROWGEN_PHILOX
+} RowRng;
+
+#define ROWGEN_RNG_HELP "lcg (drand48, the default) or philox"
+
+typedef struct {
+  long long offset;            // First key
+  long long numkeys;
+  long long rowsperkey;
+  long long chunkKeys;
+  long long numChunks;
+  RowRng rng;
+  Lcg start;                   // State before the first value
+  PhiloxKey key;
+  KeyDist dist;                // Distribution of column values
+} RowGen;
+
+int    rowgen_init(RowGen *rg, long long numkeys, long long rowsperkey,
+		   long long offset, long seed, const char *dist);
+int    rowgen_set_rng(RowGen *rg, const char *rng);
+void   rowgen_describe_rng(FILE *f, const RowGen *rg);
+void   rowgen_chunk(const RowGen *rg, long long chunk, long long *first,
+		    long long *last, ValueStream *vs);
+size_t rowgen_fields(const RowGen *rg, int64_t **fields, long long first,
+		     long long last, ValueStream *vs);
+int    rowgen_row(const RowGen *rg, long long pkey, long long ccol, int64_t *vals);
+
+#endif
@@ -0,0 +1,100 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "odbcutil.h"
+#include "stmtpool.h"
+
+/************************************************************************
+/* StmtPoolInit: allocate size statement handles on hDbc
+/*
+/* All handles are allocated here so that no SQLAllocHandle happens
+/* while the pool is in use.  On failure the handles allocated so far
+/* stay in the pool and are released by StmtPoolFree.
+/************************************************************************/
+
+RETCODE StmtPoolInit(StmtPool *pool, SQLHDBC hDbc, int size)
+{
+  memset(pool, 0, sizeof(StmtPool));
+  pool->hDbc = hDbc;
+  pool->size = (size < 1) ? 1 : size;
+  pool->handles = calloc(pool->size, sizeof(SQLHSTMT));
+  pool->free = calloc(pool->size, sizeof(SQLHSTMT));
+  if ((NULL == pool->handles) || (NULL == pool->free)) {
+    fprintf(stderr, "Unable to allocate statement pool\n");
+    return SQL_ERROR;
+  }
+
+  while (pool->numAllocated < pool->size) {
+    SQLHSTMT hStmt = NULL;
+    TRYODBC(hDbc,
+	    SQL_HANDLE_DBC,
+	    SQLAllocHandle(SQL_HANDLE_STMT, hDbc, &hStmt));
+    pool->handles[pool->numAllocated++] = hStmt;
+    pool->free[pool->numFree++] = hStmt;
+  }
+  return SQL_SUCCESS;
+
+ Exit:
+  return SQL_ERROR;
+}
+
+/************************************************************************
+/* StmtPoolGet: check a statement handle out of the pool
+/************************************************************************/
+
+RETCODE StmtPoolGet(StmtPool *pool, SQLHSTMT *phStmt)
+{
+  if (0 == pool->numFree) {
+    fprintf(stderr, "Statement pool exhausted (%d handles)\n", pool->size);
+    *phStmt = NULL;
+    return SQL_ERROR;
+  }
+  *phStmt = pool->free[--pool->numFree];
+  return SQL_SUCCESS;
+}
+
+/************************************************************************
+/* StmtPoolPut: return a statement handle to the pool
+/*
+/* The handle is closed, unbound and has its parameters reset so the
+/* next user starts from a clean statement.
+/************************************************************************/
+
+RETCODE StmtPoolPut(StmtPool *pool, SQLHSTMT hStmt)
+{
+  RETCODE ret = SQL_SUCCESS;
+
+  TRYODBC(hStmt,
+	  SQL_HANDLE_STMT,
+	  SQLFreeStmt(hStmt, SQL_CLOSE));
+  TRYODBC(hStmt,
+	  SQL_HANDLE_STMT,
+	  SQLFreeStmt(hStmt, SQL_UNBIND));
+  TRYODBC(hStmt,
+	  SQL_HANDLE_STMT,
+	  SQLFreeStmt(hStmt, SQL_RESET_PARAMS));
+  goto Done;
+
+ Exit:
+  ret = SQL_ERROR;
+ Done:
+  // Even a handle that failed to reset is still ours to free later
+  pool->free[pool->numFree++] = hStmt;
+  return ret;
+}
+
+/************************************************************************
+/* StmtPoolFree: free every handle the pool allocated
+/************************************************************************/
+
+void StmtPoolFree(StmtPool *pool)
+{
+  int i;
+
+  for (i = 0; i < pool->numAllocated; i++) {
+    SQLFreeHandle(SQL_HANDLE_STMT, pool->handles[i]);
+  }
+  free(pool->handles);
+  free(pool->free);
+  memset(pool, 0, sizeof(StmtPool));
+}
@@ -0,0 +1,31 @@
+#ifndef STMTPOOL_H
+#define STMTPOOL_H
+
+#include <sql.h>
+#include <sqlext.h>
+
+/*****************************************/
+/* Statement handle pool                 */
+/*                                       */
+/* A fixed set of statement handles on   */
+/* one connection, allocated up front    */
+/* and recycled with close/unbind/reset. */
+/*****************************************/
+
+#define DEFAULT_STMT_POOL_SIZE (1)
+
+typedef struct {
+  SQLHDBC   hDbc;
+  SQLHSTMT *handles;       // Every handle the pool owns
+  SQLHSTMT *free;          // Stack of handles not checked out
+  int       size;
+  int       numAllocated;
+  int       numFree;
+} StmtPool;
+
+RETCODE StmtPoolInit(StmtPool *pool, SQLHDBC hDbc, int size);
+RETCODE StmtPoolGet(StmtPool *pool, SQLHSTMT *phStmt);
+RETCODE StmtPoolPut(StmtPool *pool, SQLHSTMT hStmt);
+void    StmtPoolFree(StmtPool *pool);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <time.h>
+#include <errno.h>
+
+/*****************************************/
+/* Monotonic clock helpers for the       */
+/* benchmark loops                       */
+/*****************************************/
+
+#define NANOS_PER_SEC (1000000000LL)
+
+static inline long long now_nanos(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * NANOS_PER_SEC + ts.tv_nsec;
+}
+
+// Sleep until the given now_nanos() time; returns at once if it has passed
+static inline void sleep_until_nanos(long long when) {
+  struct timespec ts;
+  ts.tv_sec = when / NANOS_PER_SEC;
+  ts.tv_nsec = when % NANOS_PER_SEC;
+  while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+    ;
+}
+
+#endif